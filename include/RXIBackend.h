@@ -0,0 +1,71 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXIXInput.h"
+
+namespace RXI
+{
+
+/*
+	Backend
+	The Backend is the source of the controllers' state. It abstracts away the 
+	four XInput functions the library relies on: reading the state, the capabilities
+	and the battery information of a controller, and setting its vibration motors.
+
+	The number of slots depends on the Backend: four with XInput, but a 
+	SyntheticBackend can simulate hundreds of controllers.
+
+	The methods follow the XInput conventions: they return ERROR_SUCCESS on success,
+	ERROR_DEVICE_NOT_CONNECTED if no controller is connected at the given index,
+	or another error code.
+
+	On Windows, the XInputBackend forwards the calls to the XInput API. The 
+	SyntheticBackend keeps everything in memory and lets client code simulate 
+	controllers on any platform (for testing and benchmarking purpose for example).
+*/
+class Backend
+{
+public:
+	virtual ~Backend() {}
+
+	// The number of controller slots, i.e. the valid controller indices
+	virtual DWORD	getMaxNumControllers() const = 0;
+
+	virtual DWORD	getState( DWORD controllerIndex, XINPUT_STATE* state ) = 0;
+	virtual DWORD	getCapabilities( DWORD controllerIndex, DWORD flags, XINPUT_CAPABILITIES* capabilities ) = 0;
+	virtual DWORD	setState( DWORD controllerIndex, XINPUT_VIBRATION* vibration ) = 0;
+	virtual DWORD	getBatteryInformation( DWORD controllerIndex, BYTE devType, XINPUT_BATTERY_INFORMATION* batteryInformation ) = 0;
+
+	// Whether the methods can be called from several threads at once. The BatteryPoller 
+	// and the ControllerDiscovery query the Backend from their own thread, so they 
+	// refuse to start without it. False unless the Backend tells otherwise
+	virtual bool	isThreadSafe() const							{ return false; }
+
+	// Creates the natural backend for the platform: the XInputBackend on Windows,
+	// an empty SyntheticBackend elsewhere. The caller owns the returned object.
+	static Backend*	createDefaultBackend();
+};
+
+}
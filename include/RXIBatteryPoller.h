@@ -0,0 +1,117 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXIXInput.h"
+#include "RXISeqLock.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace RXI
+{
+
+class Backend;
+
+/*
+	BatteryPoller
+	Reads the battery information of the connected controllers on a background 
+	thread, so that the game thread never waits for these driver queries. 
+
+	Each slot is queried right after the controller gets connected, then every 
+	intervalInMs (10 s by default). When the battery of the controller runs low, 
+	it's queried more often (every lowLevelIntervalInMs, 2 s by default) so that 
+	the game can warn the player in time.
+
+	The results are published per slot through a SeqLock. The ControllerManager 
+	owns a BatteryPoller when asynchronous battery polling is enabled, and each 
+	Controller applies the latest result during its update (see 
+	ControllerManager::setAsynchronousBatteryPollingEnabled()).
+
+	The Backend must support getBatteryInformation() being called from the poller 
+	thread while the other methods are called from the thread updating the 
+	ControllerManager: the poller doesn't start unless Backend::isThreadSafe(). 
+	The XInput, synthetic and evdev backends are.
+*/
+class BatteryPoller
+{
+public:
+	struct Report
+	{
+		XINPUT_BATTERY_INFORMATION	batteryInformation[2];		// Indexed by BATTERY_DEVTYPE_GAMEPAD/BATTERY_DEVTYPE_HEADSET
+	};
+
+	BatteryPoller( Backend* backend, DWORD numMaxControllers );
+	virtual ~BatteryPoller();
+
+	// Can be changed at any time, they apply from the next query of each slot
+	void				setIntervalInMs( unsigned int intervalInMs )			{ mIntervalInMs = intervalInMs; }
+	unsigned int		getIntervalInMs() const									{ return mIntervalInMs.load(); }
+	void				setLowLevelIntervalInMs( unsigned int intervalInMs )	{ mLowLevelIntervalInMs = intervalInMs; }
+	unsigned int		getLowLevelIntervalInMs() const							{ return mLowLevelIntervalInMs.load(); }
+
+	// Fails if the Backend isn't thread-safe
+	bool				start();
+	void				stop();
+	bool				isRunning() const						{ return mThread.joinable(); }
+
+	// Tells the poller which slots to query. A slot that gets connected is 
+	// queried as soon as possible
+	void				setControllerConnected( DWORD controllerIndex, bool connected );
+
+	// Consumer side. The version is incremented each time a new report is 
+	// published for the slot, so that it's only applied once
+	unsigned int		getReportVersion( DWORD controllerIndex ) const	{ return mReports[controllerIndex].getVersion(); }
+	void				getReport( DWORD controllerIndex, Report& report ) const	{ mReports[controllerIndex].load( report ); }
+
+	unsigned long long	getNumQueries() const					{ return mNumQueries.load(); }
+
+private:
+	BatteryPoller( const BatteryPoller& );
+	BatteryPoller& operator=( const BatteryPoller& );
+
+	void				run();
+	void				poll( DWORD controllerIndex, unsigned long long int timeInNs );
+
+	static const unsigned int		mWakeUpIntervalInMs = 20;
+
+	Backend*						mBackend;
+	DWORD							mNumMaxControllers;
+	std::atomic<unsigned int>		mIntervalInMs;
+	std::atomic<unsigned int>		mLowLevelIntervalInMs;
+	std::thread						mThread;
+	std::atomic<bool>				mStopRequested;
+	std::atomic<unsigned long long>	mNumQueries;
+
+	// Shared with the poller thread
+	std::vector<std::atomic<bool> >	mIsConnected;
+	std::vector<std::atomic<bool> >	mIsQueryRequested;
+	std::vector<SeqLock<Report> >	mReports;
+
+	// Poller thread only
+	std::vector<unsigned long long int>	mNextQueryTimesInNs;
+};
+
+}
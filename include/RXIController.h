@@ -23,15 +23,20 @@
 */
 #pragma once
 
-#define WIN32_LEAN_AND_MEAN 
-#define NOMINMAX 
-#include <windows.h>
+#include "RXITypes.h"
+#include "RXISeqLock.h"
+#include "RXILatencyProfile.h"
 
+#include <string>
 #include <vector>
 
 namespace RXI
 {
 
+class Backend;
+class BatteryPoller;
+class InputRecorder;
+
 /*
 	Controller
 	This class represents a generic XBox 360 controller. 
@@ -51,6 +56,15 @@ namespace RXI
 	Finally, information is available concerning  the battery level and type if 
 	the device is wireless. This information is also provided for an optional headset
 	connected to it.
+
+	The Controller is meant to be used from the thread that updates the ControllerManager.
+	Other threads (render, audio...) can read a consistent snapshot of the whole 
+	component state through getState(), which is lock-free and never blocks the update.
+	They must stop doing so once the Controller is disconnected.
+
+	The ControllerManager reuses the same Controller object each time a device 
+	is connected to a given slot. It is reset to its default settings on connection 
+	and its listeners are removed.
 */
 class Controller
 {
@@ -145,24 +159,71 @@ public:
 	static const char*	getComponentTypeName( ComponentTypeID componentTypeID )		{ return mComponentTypeName[componentTypeID]; }
 	
 	static const char*	getButtonName( ButtonID buttonID )							{ return mButtonName[buttonID]; }
+	static WORD			getButtonXInputID( ButtonID buttonID )						{ return mButtonXInputID[buttonID]; }	// Its bit in XINPUT_GAMEPAD::wButtons
 	bool				hasButton( ButtonID buttonID ) const						{ return mHasButton[buttonID]; }
 	bool				isButtonPressed( ButtonID buttonID ) const					{ return mIsButtonPressed[buttonID]; }
 	
 	static const char*	getTriggerName( TriggerID triggerID )						{ return mTriggerName[triggerID]; }
 	bool				hasTrigger( TriggerID triggerID ) const						{ return mHasTrigger[triggerID]; }
 	BYTE				getTriggerPosition( TriggerID triggerID ) const				{ return mTriggerPosition[triggerID]; }
+	void				setTriggerDeadZone( TriggerID triggerID, BYTE deadZone );
+	BYTE				getTriggerDeadZone( TriggerID triggerID ) const				{ return mTriggerDeadZone[triggerID]; }
+
+	// The response curve is applied to the trigger position after the dead zone
+	enum ResponseCurve
+	{
+		ResponseCurve_Linear,
+		ResponseCurve_Quadratic,		// More precision at the beginning of the travel
+		ResponseCurve_Cubic,
+		ResponseCurve_Count
+	};
+	void				setTriggerResponseCurve( TriggerID triggerID, ResponseCurve curve );
+	ResponseCurve		getTriggerResponseCurve( TriggerID triggerID ) const		{ return mTriggerResponseCurve[triggerID]; }
+	static BYTE			applyTriggerDeadZone( BYTE position, BYTE deadZoneRadius );
 
 	static const char*	getThumbstickName( ThumbstickID thumbstickID )				{ return mThumbstickName[thumbstickID]; }
 	bool				hasThumbstick( ThumbstickID thumbstickID ) const			{ return mHasThumbstick[thumbstickID]; }
 	void				getThumbstickPosition( ThumbstickID thumbstickID, SHORT& positionX, SHORT& positionY ) const { positionX = mThumbstickXPosition[thumbstickID];	positionY = mThumbstickYPosition[thumbstickID]; }
-	void				setThumbstickDeadZoneRadius( ThumbstickID thumbstickID, SHORT radiusX, SHORT radiusY );
-	void				getThumbstickDeadZoneRadius( ThumbstickID thumbstickID, SHORT& radiusX, SHORT& radiusY ) const;
+	void				setThumbstickDeadZoneRadius( ThumbstickID thumbstickID, SHORT radius );
+	SHORT				getThumbstickDeadZoneRadius( ThumbstickID thumbstickID ) const	{ return mThumbstickDeadZoneRadius[thumbstickID]; }
+
+	// How the radial dead zone is computed. The fixed-point method uses integer 
+	// arithmetic only and skips the square root when the stick is inside the dead 
+	// zone. It differs from the floating-point one by at most one unit per axis for 
+	// radii up to 32700. Above, the single-precision floating-point method loses 
+	// accuracy (tens of units at 32766) while the fixed-point one stays within a 
+	// few units of the exact result. A radius of 32767 filters everything out
+	enum DeadZoneMethod
+	{
+		DeadZoneMethod_FloatingPoint,
+		DeadZoneMethod_FixedPoint,
+		DeadZoneMethod_Count
+	};
+	void				setThumbstickDeadZoneMethod( DeadZoneMethod method );
+	DeadZoneMethod		getThumbstickDeadZoneMethod() const							{ return mThumbstickDeadZoneMethod; }
+	static void			applyThumbstickDeadZone( SHORT inX, SHORT inY, SHORT& outX, SHORT& outY, SHORT deadZoneRadius );
+	static void			applyThumbstickDeadZoneFixedPoint( SHORT inX, SHORT inY, SHORT& outX, SHORT& outY, SHORT deadZoneRadius );
 
 	static const char*	getVibrationMotorName( VibrationMotorID motorID )			{ return mVibrationMotorName[motorID]; }
 	bool				hasVibrationMotor( VibrationMotorID motorID )				{ return mHasVibrationMotor[motorID]; }
 	WORD				getVibrationMotorSpeed( VibrationMotorID motorID ) const	{ return mVibrationMotorSpeed[motorID]; }
+	
+	// Sets the speed of a motor. By default the device is written to immediately. When 
+	// the ControllerManager coalesces the vibration writes, the speed is only staged: 
+	// the last speeds of both motors are sent in a single write during the next 
+	// ControllerManager::update(), and nothing is sent if they didn't change. 
+	// getVibrationMotorSpeed() and the notifications reflect what was actually written
 	void				setVibrationMotorSpeed( VibrationMotorID motorID, WORD speed );
 
+	// Sets the speeds of both motors at once, in a single write (or staged the same way). 
+	// The speed of a missing motor is left unchanged
+	void				setVibration( WORD leftSpeed, WORD rightSpeed );
+
+	// The number of setVibrationMotorSpeed() calls and of writes actually sent to the 
+	// device, since the ControllerManager started to use this slot
+	unsigned int		getNumVibrationWritesRequested() const						{ return mNumVibrationWritesRequested; }
+	unsigned int		getNumVibrationWritesIssued() const							{ return mNumVibrationWritesIssued; }
+
 	static const char*	getBatteryTypeName( BatteryType batteryType )				{ return mBatteryTypeName[batteryType]; }
 	static const char*	getBatteryName( BatteryID batteryID )						{ return mBatteryName[batteryID]; }
 	bool				hasBattery( BatteryID batteryID ) const						{ return mHasBattery[batteryID]; }
@@ -171,6 +232,27 @@ public:
 	// Returns a value between 0 and getBatteryLevelMax()
 	BYTE				getBatteryLevel( BatteryID batteryID ) const				{ return mBatteryLevel[batteryID]; }
 
+	// A copy of the state of all the components, published at the end of each update
+	struct State
+	{
+		DWORD			packetNumber;
+		unsigned long long int timestampInNs;		// When the packet was read from the device
+		bool			isButtonPressed[Button_Count];
+		BYTE			triggerPosition[Trigger_Count];
+		SHORT			thumbstickXPosition[Thumbstick_Count];
+		SHORT			thumbstickYPosition[Thumbstick_Count];
+		WORD			vibrationMotorSpeed[VibrationMotor_Count];
+		BYTE			batteryLevel[Battery_Count];
+	};
+
+	// Can be called from any thread
+	void				getState( State& state ) const								{ mPublishedState.load( state ); }
+	unsigned int		getStateVersion() const										{ return mPublishedState.getVersion(); }
+
+	// When the packet of the last update was read from the device (see Timestamp). 
+	// Listeners can call it to know when the change they're notified of happened
+	unsigned long long int getUpdateTimestampInNs() const							{ return mUpdateTimestampInNs; }
+
 	// XInput 1.4 Windows 8 only. Returns empty strings otherwise.
 	bool				getWindowsCoreAudioDeviceIds( std::wstring& renderDeviceId, std::wstring& captureDeviceId ) const;
 	
@@ -180,6 +262,7 @@ public:
 	class Listener
 	{
 	public:
+		virtual ~Listener() {}
 		virtual void onComponentChanged( Controller* /*controller*/, ComponentTypeID /*componentTypeID*/, int /*componentID*/ ) {}
 	};
 
@@ -188,40 +271,94 @@ public:
 	bool				removeListener( Listener* listener );
 	Listeners			getListeners() const { return mListeners; }
 
+	// A change of a component. Thumbsticks use both values of the arrays (X and Y), 
+	// the other components only the first one
+	struct ComponentChange
+	{
+		ComponentTypeID	componentTypeID;
+		int				componentID;
+		int				oldValue[2];
+		int				newValue[2];
+		unsigned long long int timestampInNs;
+	};
+
+	// Rather than being called once per component change, a BatchListener receives 
+	// all the changes of an update at once, in the order they happened. Changes happening 
+	// outside of an update (vibration motors set by the client code) are delivered 
+	// immediately as a batch of one. The array is only valid during the call
+	class BatchListener
+	{
+	public:
+		virtual ~BatchListener() {}
+		virtual void onComponentsChanged( Controller* /*controller*/, const ComponentChange* /*changes*/, std::size_t /*numChanges*/ ) {}
+	};
+
+	typedef				std::vector<BatchListener*> BatchListeners; 
+	void				addBatchListener( BatchListener* listener );
+	bool				removeBatchListener( BatchListener* listener );
+	BatchListeners		getBatchListeners() const { return mBatchListeners; }
+
 private:
 	friend class ControllerManager;
-	Controller( DWORD controllerIndex, const void* xinputState );
+	Controller( Backend* backend, DWORD controllerIndex, LatencyProfile* latencyProfile );
 	virtual ~Controller();
 
+	void				connect( const void* xinputState, unsigned long long int timestampInNs, const void* xinputCapabilities=NULL, const void* xinputBatteryInformation=NULL );
+	void				disconnect();
+	void				recordConnection();
+
 	void				clearCapabilities();
 	void				clearState();
-	void				updateCapabilities();
-	void				update( const void* xinputState );
+	void				updateCapabilities( void* xinputCapabilities );
+	void				applyCapabilities( const void* xinputCapabilities );
+	void				update( const void* xinputState, unsigned long long int timestampInNs, const SHORT* filteredThumbstickPositions=NULL );
 	
 	void				setButtonPressed( ButtonID button, bool pressed );
-	static BYTE			applyTriggerDeadZone( BYTE position, BYTE deadZoneRadius );
 	void				setTriggerPosition( TriggerID trigger, BYTE position );
-	static void			applyThumbstickDeadZone( SHORT inX, SHORT inY, SHORT& outX, SHORT& outY, SHORT deadZoneRadius );
 	void				setThumbstickPosition( ThumbstickID thumbstick, SHORT positionX, SHORT positionY );
+	void				setFilteredThumbstickPosition( ThumbstickID thumbstick, SHORT positionX, SHORT positionY );
 	void				getBatteryInformation( BatteryID batteryID, bool& hasBattery, BatteryType& batteryType, BYTE& batteryLevel ) const;
-	void				setBatteryInformation( BatteryID batteryID, bool hasBattery, BatteryType batteryType, BYTE batteryLevel );
+	void				updateBattery( unsigned long long int timestampInNs );
+	bool				updateNextBattery( unsigned long long int timestampInNs );
+	void				applyBatteryReport( unsigned long long int timestampInNs );
+	void				setBatteryPoller( const BatteryPoller* batteryPoller );
+	bool				setBatteryInformation( BatteryID batteryID, bool hasBattery, BatteryType batteryType, BYTE batteryLevel );
+	void				recordBattery( unsigned long long int timestampInNs );
+	unsigned long long int getRecordTimestampInNs() const;
+	void				publishState();
+	bool				writeVibrationMotorSpeeds( WORD leftSpeed, WORD rightSpeed, bool force );
+	void				flushVibration();
+	void				reapplyThumbstickDeadZones();
+	void				updateTriggerTable( TriggerID triggerID );
+	void				notifyComponentChanged( ComponentTypeID componentTypeID, int componentID, int oldValue, int newValue, int oldValueY=0, int newValueY=0 );
+	void				beginChanges( unsigned long long int timestampInNs );
+	void				endChanges();
 	
 	static SubType		xinputSubTypeToSubType( int xinputSubType );
 	static bool			xinputBatteryTypeToBatteryType( BYTE xinputBatteryType, Controller::BatteryType& batteryType );
+	static void			xinputBatteryInformationToBatteryInformation( const void* xinputBatteryInformation, bool& hasBattery, BatteryType& batteryType, BYTE& batteryLevel );
+	static void			batteryInformationToXInputBatteryInformation( bool hasBattery, BatteryType batteryType, BYTE batteryLevel, void* xinputBatteryInformation );
 
 	static const char*	mSubTypeName[SubType_Count];
 	static const char*	mComponentTypeName[ComponentType_Count];
 	static const char*	mButtonName[Button_Count];
 	static const WORD	mButtonXInputID[Button_Count];
+	static const int	mXInputBitButtonID[16];
 	static const char*	mTriggerName[Trigger_Count];
 	static const char*	mThumbstickName[Thumbstick_Count];
 	static const char*	mVibrationMotorName[VibrationMotor_Count];
 	static const char*	mBatteryTypeName[BatteryType_Count];
 	static const char*	mBatteryName[Battery_Count];
 	
-	static const unsigned int mBatteryUpdateIntervalInMs = 10000;	
+	static const std::size_t mNumReservedListeners = 4;
+	static const std::size_t mNumReservedChanges = 32;
 	
 	// Controller information
+	Backend*			mBackend;
+	InputRecorder*		mRecorder;
+	LatencyProfile*		mLatencyProfile;
+	unsigned long long int mExcludedTimeInNs;				// Time spent in the dead zones and listeners during an update
+	bool				mIsUpdating;
 	DWORD				mControllerIndex;
 	SubType				mSubType;
 	
@@ -234,20 +371,49 @@ private:
 	bool				mHasBattery[Battery_Count];
 	
 	// State
-	unsigned int		mNextBatteryUpdateTime;
+	unsigned long long int mUpdateTimestampInNs;
+	unsigned long long int mBatteryUpdateIntervalInNs;
+	unsigned long long int mNextBatteryUpdateTimeInNs;
+	bool				mIsBatteryUpdateScheduled;			// When set, the ControllerManager calls updateNextBattery() when it's due
+	unsigned int		mNextUpdatedBattery;				// The BatteryID updateNextBattery() queries
+	const BatteryPoller* mBatteryPoller;					// When set, the battery information comes from it
+	unsigned int		mBatteryReportVersion;				// The version of the last report applied
 	DWORD				mLastPacketNumber;	
 	bool				mIsButtonPressed[Button_Count];		
 	BYTE				mTriggerPosition[Trigger_Count];
 	BYTE				mTriggerDeadZone[Trigger_Count];
+	ResponseCurve		mTriggerResponseCurve[Trigger_Count];
+	BYTE				mTriggerTable[Trigger_Count][256];		// Dead zone and response curve for each possible raw position
 	SHORT				mThumbstickXPosition[Thumbstick_Count];
 	SHORT				mThumbstickYPosition[Thumbstick_Count];
 	SHORT				mThumbstickDeadZoneRadius[Thumbstick_Count];
+	DeadZoneMethod		mThumbstickDeadZoneMethod;
+	WORD				mRawButtons;						// The raw values of the last packet, before dead zones are applied
+	BYTE				mRawTriggerPosition[Trigger_Count];
+	SHORT				mRawThumbstickXPosition[Thumbstick_Count];
+	SHORT				mRawThumbstickYPosition[Thumbstick_Count];
 	WORD				mVibrationMotorSpeed[VibrationMotor_Count];
+	WORD				mRequestedVibrationMotorSpeed[VibrationMotor_Count];	// Staged until the next flush when coalescing
+	bool				mIsVibrationCoalescingEnabled;
+	bool				mIsVibrationPending;
+	unsigned int		mNumVibrationWritesRequested;
+	unsigned int		mNumVibrationWritesIssued;
 	BatteryType			mBatteryType[Battery_Count];
 	BYTE				mBatteryLevel[Battery_Count];
 	
+	// State snapshot for the other threads
+	bool				mIsStateDirty;
+	SeqLock<State>		mPublishedState;
+
 	// Listeners
 	Listeners			mListeners;
+	BatchListeners		mBatchListeners;
+	
+	// Batched changes
+	unsigned int		mChangesDepth;				// Non-zero while changes are being accumulated 
+	unsigned long long int mChangesTimestampInNs;
+	std::vector<ComponentChange> mPendingChanges;
+	std::vector<ComponentChange> mDispatchedChanges;
 };
 
 }
@@ -0,0 +1,114 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXIXInput.h"
+#include "RXIRingBuffer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RXI
+{
+
+class Backend;
+
+/*
+	ControllerDiscovery
+	Finds out what a newly connected controller is on a background thread: its 
+	capabilities, the information about its batteries, and stops its motors. 
+	These driver queries can be slow, and several pads can be plugged in at once.
+
+	The ControllerManager owns a ControllerDiscovery when asynchronous connection 
+	is enabled (see ControllerManager::setAsynchronousConnectionEnabled()). It 
+	requests the discovery of the slots that get connected, and creates their 
+	Controller object from the result once it's available.
+
+	Requests are rare and go through a mutex. The results are published through a 
+	lock-free RingBuffer, so checking for them on every update costs nothing.
+
+	The Backend must support getCapabilities(), getBatteryInformation() and setState() 
+	being called from the discovery thread while the other methods are called from 
+	the thread updating the ControllerManager: the discovery doesn't start unless 
+	Backend::isThreadSafe(). The XInput, synthetic and evdev backends are.
+*/
+class ControllerDiscovery
+{
+public:
+	struct Result
+	{
+		DWORD						controllerIndex;
+		unsigned int				requestID;				// As passed to requestDiscovery()
+		DWORD						capabilitiesResult;		// ERROR_SUCCESS if the capabilities could be read
+		XINPUT_CAPABILITIES			capabilities;
+		XINPUT_BATTERY_INFORMATION	batteryInformation[2];	// Indexed by BATTERY_DEVTYPE_GAMEPAD/BATTERY_DEVTYPE_HEADSET
+	};
+
+	ControllerDiscovery( Backend* backend, DWORD numMaxControllers );
+	virtual ~ControllerDiscovery();
+
+	// Fails if the Backend isn't thread-safe
+	bool				start();
+	void				stop();
+	bool				isRunning() const						{ return mThread.joinable(); }
+
+	// Producer side. The request ID lets the caller recognize the results 
+	// of the requests it has given up on in the meantime
+	void				requestDiscovery( DWORD controllerIndex, unsigned int requestID );
+
+	// Consumer side. Pops the oldest result, returns false if there's none
+	bool				popResult( Result& result )				{ return mResults.pop( result ); }
+
+	unsigned long long	getNumDiscoveries() const				{ return mNumDiscoveries.load(); }
+
+private:
+	ControllerDiscovery( const ControllerDiscovery& );
+	ControllerDiscovery& operator=( const ControllerDiscovery& );
+
+	struct Request
+	{
+		DWORD			controllerIndex;
+		unsigned int	requestID;
+	};
+
+	void				run();
+	void				discover( const Request& request, Result& result );
+
+	Backend*						mBackend;
+	DWORD							mNumMaxControllers;
+	std::thread						mThread;
+	std::atomic<unsigned long long>	mNumDiscoveries;
+
+	// Shared with the discovery thread
+	std::mutex						mMutex;
+	std::condition_variable			mCondition;
+	bool							mStopRequested;
+	std::vector<Request>			mRequests;
+	RingBuffer<Result>				mResults;
+};
+
+}
@@ -25,10 +25,17 @@
 
 #include "RXIController.h"
 
+#include <utility>
+
 namespace RXI
 {
 
 class ControllerEnumerationTrigger;
+class Backend;
+class BatteryPoller;
+class ControllerDiscovery;
+class HapticEngine;
+class InputRecorder;
 
 /*
 	ControllerManager
@@ -42,17 +49,148 @@ class ControllerEnumerationTrigger;
 	Besides the polling approach, the client code can register to notifications that
 	inform it of newly connected or removed Controllers (the notifications are sent
 	during the update). Note that the listener is not owned by the ControllerManager.
+
+	The state of the controllers is read from a Backend. By default, the manager 
+	creates and owns the natural Backend of the platform (XInput on Windows). 
+	The client code can instead provide its own Backend (a SyntheticBackend for 
+	example), in which case it remains owned by the client and must outlive the 
+	manager.
+
+	The manager has as many controller slots as the Backend. The connected 
+	controllers are kept in a list, so the cost of an update depends on the 
+	number of connected controllers, not on the number of slots. Only the 
+	periodic enumeration of new controllers goes through all the slots, which 
+	can be spread over several updates (see setControllerEnumerationBudget()).
 */
 class ControllerManager
 {
 public:
-	ControllerManager();
+	ControllerManager( Backend* backend=NULL );
 	virtual ~ControllerManager();
+
+	Backend*	getBackend() const								{ return mBackend; }
 	
 	DWORD		getMaxNumControllers() const					{ return mNumMaxControllers; }
 	Controller*	getController( DWORD controllerIndex ) const	{ return mControllers[controllerIndex]; }
 	
 	void		update();
+
+	// The empty slots are probed for new controllers every interval, 1 s by default. 
+	// Probing an empty slot is expensive with XInput
+	void		setControllerEnumerationIntervalInMs( unsigned int intervalInMs )	{ mControllerEnumerationIntervalInMs = intervalInMs; }
+	unsigned int getControllerEnumerationIntervalInMs() const		{ return mControllerEnumerationIntervalInMs; }
+
+	// By default, all the empty slots are probed by the same update. With a budget, at most 
+	// that many are probed per update, round-robin, so that the cost of an enumeration is 
+	// spread over several frames instead of causing a periodic hitch. 0 means no limit
+	void		setControllerEnumerationBudget( DWORD numSlotsPerUpdate )	{ mControllerEnumerationBudget = numSlotsPerUpdate; }
+	DWORD		getControllerEnumerationBudget() const			{ return mControllerEnumerationBudget; }
+
+	// With a maintenance budget, update() first updates the connected controllers, then runs 
+	// the maintenance tasks by priority until the update has lasted that long: probing the 
+	// empty slots for new controllers first, then refreshing the battery information that is 
+	// due, the most overdue first. The rest is carried over to the next updates. A task is 
+	// a single query: one empty slot probe, or the battery of the controller or of the headset. 
+	// Each update runs at least one, so it can overrun the budget by the cost of a query 
+	// (about 500 us for a wireless battery). This keeps the cost of an update predictable 
+	// under load. 0, the default, means no budget: each task is done as soon as it's due
+	void		setMaintenanceBudgetInUs( unsigned int budgetInUs );
+	unsigned int getMaintenanceBudgetInUs() const				{ return mMaintenanceBudgetInUs; }
+	
+	// The number of maintenance tasks left to the next updates by the last one: the empty 
+	// slots left to probe and the battery queries still due
+	std::size_t	getNumDeferredMaintenanceTasks() const			{ return mNumDeferredMaintenanceTasks; }
+	
+	// When batch processing is enabled, update() first reads the state of all the 
+	// controllers, then applies the thumbstick dead zones of all of them at once using 
+	// the vectorized DeadZoneKernels, and finally updates each Controller. This gives 
+	// the same results and pays off when many controllers are connected
+	void		setBatchProcessingEnabled( bool enabled )		{ mIsBatchProcessingEnabled = enabled; }
+	bool		isBatchProcessingEnabled() const				{ return mIsBatchProcessingEnabled; }
+
+	// The Controller objects are pooled: one per slot, created on the first connection 
+	// to the slot and reused on the next ones, so reconnecting a controller doesn't 
+	// allocate memory. This creates the Controller objects of all the slots up front 
+	// so that even the first connections don't
+	void		preallocateControllers();
+
+	// The latency of each stage of the update path, when the library is compiled 
+	// with RXI_ENABLE_LATENCY_PROFILING (see LatencyProfile)
+	const LatencyProfile&	getLatencyProfile() const			{ return mLatencyProfile; }
+	void		resetLatencyProfile()							{ mLatencyProfile.reset(); }
+
+	// When enabled, Controller::setVibrationMotorSpeed() only stages the speeds and 
+	// update() sends them, one write per controller for both motors at most. 
+	// flushVibrations() sends them immediately. Disabled by default
+	void		setVibrationCoalescingEnabled( bool enabled );
+	bool		isVibrationCoalescingEnabled() const			{ return mIsVibrationCoalescingEnabled; }
+	void		flushVibrations();
+	
+	// The sums of the counters of all the Controllers (see Controller::getNumVibrationWritesRequested())
+	unsigned long long int getNumVibrationWritesRequested() const;
+	unsigned long long int getNumVibrationWritesIssued() const;
+
+	// How often the battery information of each controller is queried, 10 s by default
+	void		setBatteryUpdateIntervalInMs( unsigned int intervalInMs );
+	unsigned int getBatteryUpdateIntervalInMs() const			{ return mBatteryUpdateIntervalInMs; }
+
+	// When enabled, the battery information is queried by a BatteryPoller on a background 
+	// thread, instead of synchronously during update() which then never waits for these 
+	// driver queries. The Controllers apply the latest information during their update. 
+	// The poller queries a battery running low more often. Disabled by default. Enabling 
+	// it fails (and returns false) if the Backend isn't thread-safe
+	bool		setAsynchronousBatteryPollingEnabled( bool enabled );
+	bool		isAsynchronousBatteryPollingEnabled() const		{ return mBatteryPoller!=NULL; }
+	BatteryPoller* getBatteryPoller() const						{ return mBatteryPoller; }
+
+	// When enabled, a controller that gets connected is first handed to a ControllerDiscovery 
+	// thread which queries its capabilities and battery information. The listeners receive 
+	// onControllerConnecting() right away, then a later update creates the Controller object 
+	// once it's ready and sends onControllerConnected(). The update that detects a new 
+	// controller doesn't wait for the driver. Disabled by default. Enabling it fails (and 
+	// returns false) if the Backend isn't thread-safe
+	bool		setAsynchronousConnectionEnabled( bool enabled );
+	bool		isAsynchronousConnectionEnabled() const			{ return mControllerDiscovery!=NULL; }
+	bool		isControllerConnecting( DWORD controllerIndex ) const	{ return mIsControllerConnecting[controllerIndex]; }
+	DWORD		getNumConnectingControllers() const				{ return mNumConnectingControllers; }
+
+	// Creates the Controller objects whose discovery is over. update() calls it. Client code 
+	// calling updateController() directly must call it regularly as well (Sampler::drain() does)
+	void		updateConnectingControllers();
+
+	// Records what the Controllers see (see InputRecorder) from now on. The recorder is 
+	// not owned by the manager. NULL stops the recording
+	void		setRecorder( InputRecorder* recorder );
+	InputRecorder* getRecorder() const							{ return mRecorder; }
+
+	// Applies the motor speeds staged by a HapticEngine to the controllers it plays effects 
+	// on, during each update. The engine is not owned by the manager and must have at least 
+	// as many slots. NULL detaches it
+	void		setHapticEngine( HapticEngine* hapticEngine )	{ mHapticEngine = hapticEngine; }
+	HapticEngine* getHapticEngine() const						{ return mHapticEngine; }
+
+	// Applies the speeds staged by the HapticEngine. update() calls it. Client code calling 
+	// updateController() directly must call it regularly as well (followed by flushVibrations() 
+	// when the vibration writes are coalesced)
+	void		applyHapticVibrations();
+
+	// Updates a single controller slot: creates, updates or deletes the Controller object 
+	// depending on what the Backend reports. update() calls it on each slot. It can be 
+	// called directly by client code that knows which controllers changed (when using an 
+	// event-driven Backend for example)
+	void		updateController( DWORD controllerIndex );
+	
+	// Same as above but with a state that has already been read from the Backend 
+	// (by a Sampler for example). A NULL state means the controller is not connected. 
+	// The timestamp tells when the state was read (see Timestamp), the current time 
+	// is used when it's not given
+	void		updateController( DWORD controllerIndex, const void* xinputState );
+	void		updateController( DWORD controllerIndex, const void* xinputState, unsigned long long int timestampInNs );
+
+	// Makes the Controller of a slot query its battery information right away, rather than 
+	// when its next battery update is due. A ReplayBackend calls it to replay the recorded 
+	// battery changes at their time
+	void		updateControllerBattery( DWORD controllerIndex, unsigned long long int timestampInNs );
 	
 	enum XInputVersion
 	{
@@ -68,7 +206,11 @@ public:
 	class Listener
 	{
 	public:
+		virtual ~Listener() {}
+
 		// Called whenever a controller is being connected. The manager hasn't created the Controller object yet.
+		// With asynchronous connection, this happens when its discovery starts. If the controller goes away 
+		// before it's over, onControllerConnected() is never called
 		virtual void	onControllerConnecting( ControllerManager* /*controllerManager*/ ) {}
 		
 		// Called whenever a controller has been connected. The Controller object has been created by the manager, 
@@ -79,8 +221,9 @@ public:
 		// so it's still present in the list. This gives a last chance to do things before it gets removed 
 		virtual void	onControllerDisconnecting( ControllerManager* /*controllerManager*/, Controller* /*controller*/ ) {}
 		
-		// Called whenever a controller is disconnected. The Controller object passed as a parameter has been deleted 
-		// by the manager and *should not be used*. It is passed for information purpose only.
+		// Called whenever a controller is disconnected. The Controller object passed as a parameter is no longer 
+		// in use by the manager and *should not be used* (it will be reset and reused if a controller gets 
+		// connected to the same slot). It is passed for information purpose only.
 		virtual void	onControllerDisconnected( ControllerManager* /*controllerManager*/, Controller* /*controller*/ ) {}
 	};
 	
@@ -90,18 +233,52 @@ public:
 	Listeners		getListeners() const { return mListeners; }
 
 private:
-	Controller*		addController( DWORD controllerIndex, const void* xinputState );
-	void			updateController( DWORD controllerIndex );
+	Controller*		createController( DWORD controllerIndex );
+	Controller*		addController( DWORD controllerIndex, const void* xinputState, unsigned long long int timestampInNs, const void* xinputCapabilities=NULL, const void* xinputBatteryInformation=NULL );
 	void			deleteController( DWORD controllerIndex );
 	void			deleteAllControllers();
+	void			requestControllerDiscovery( DWORD controllerIndex );
+	void			cancelControllerDiscovery( DWORD controllerIndex );
+	void			updateControllersInBatch( const std::vector<DWORD>& controllerIndices );
+	void			runMaintenanceTasks( unsigned long long int updateStartTimeInNs );
 
-	static const DWORD			mNumMaxControllers;
-	static unsigned int			mControllerEnumerationIntervalInMs;
 	static const char*			mXInputVersionStrings[XInputVersion_Count];
 
-	unsigned int				mNextControllerEnumerationTime;
-	std::vector<Controller*>	mControllers;
+	Backend*					mBackend;
+	bool						mOwnsBackend;
+	DWORD						mNumMaxControllers;
+	unsigned int				mControllerEnumerationIntervalInMs;
+	DWORD						mControllerEnumerationBudget;
+	unsigned long long int		mNextControllerEnumerationTimeInNs;
+	DWORD						mNextEnumeratedControllerIndex;	// Where the enumeration in progress is, or the number of slots
+	std::vector<Controller*>	mControllers;					// The connected controllers, NULL for the empty slots
+	std::vector<Controller*>	mControllerPool;				// The Controller objects of each slot, connected or not
+	std::vector<DWORD>			mConnectedControllerIndices;	// Sorted
+	std::vector<DWORD>			mEnumeratedControllerIndices;	// The empty slots probed during an update
+	std::vector<DWORD>			mUpdatedControllerIndices;		// The slots to go through during an update
+	unsigned int				mMaintenanceBudgetInUs;
+	std::vector< std::pair<unsigned long long int, DWORD> > mDueBatteryUpdates;	// Deadline and slot
+	std::size_t					mNumDeferredMaintenanceTasks;
 	Listeners					mListeners;
+	
+	LatencyProfile				mLatencyProfile;
+	InputRecorder*				mRecorder;
+	HapticEngine*				mHapticEngine;
+	std::vector<bool>			mIsHapticEffectPlaying;			// As of the last applyHapticVibrations()
+	bool						mIsVibrationCoalescingEnabled;
+	unsigned int				mBatteryUpdateIntervalInMs;
+	BatteryPoller*				mBatteryPoller;
+
+	// Asynchronous connection
+	ControllerDiscovery*		mControllerDiscovery;
+	std::vector<bool>			mIsControllerConnecting;		// Waiting for the discovery to be over
+	std::vector<unsigned int>	mConnectionRequestIDs;			// The discovery requested last for each slot
+	DWORD						mNumConnectingControllers;
+
+	// Batch processing
+	struct BatchBuffers;
+	bool						mIsBatchProcessingEnabled;
+	BatchBuffers*				mBatchBuffers;
 };
 
 }
@@ -0,0 +1,74 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXITypes.h"
+
+#include <cstddef>
+
+namespace RXI
+{
+
+/*
+	DeadZoneKernels
+	Applies the floating-point radial dead zone (see Controller::applyThumbstickDeadZone) 
+	to many thumbsticks at once. The positions are given as a structure of arrays: 
+	one array of X values, one of Y values and one of dead zone radii.
+
+	Vectorized versions (SSE2 and AVX2) process 4 or 8 thumbsticks per iteration and 
+	produce the exact same values as the scalar version. The best instruction set 
+	supported by the CPU is detected at startup. It can be overridden, for 
+	benchmarking purpose for example.
+*/
+class DeadZoneKernels
+{
+public:
+	enum InstructionSet
+	{
+		InstructionSet_Scalar,
+		InstructionSet_SSE2,
+		InstructionSet_AVX2,
+		InstructionSet_Count
+	};
+
+	static void				applyThumbstickDeadZones( const SHORT* inX, const SHORT* inY, const SHORT* deadZoneRadius, SHORT* outX, SHORT* outY, std::size_t count );
+
+	static bool				isInstructionSetSupported( InstructionSet instructionSet );
+	static InstructionSet	getInstructionSet()								{ return mInstructionSet; }
+	static bool				setInstructionSet( InstructionSet instructionSet );
+	static const char*		getInstructionSetName( InstructionSet instructionSet )	{ return mInstructionSetNames[instructionSet]; }
+
+private:
+	DeadZoneKernels();
+
+	static void				applyThumbstickDeadZonesScalar( const SHORT* inX, const SHORT* inY, const SHORT* deadZoneRadius, SHORT* outX, SHORT* outY, std::size_t count );
+	static void				applyThumbstickDeadZonesSSE2( const SHORT* inX, const SHORT* inY, const SHORT* deadZoneRadius, SHORT* outX, SHORT* outY, std::size_t count );
+	static void				applyThumbstickDeadZonesAVX2( const SHORT* inX, const SHORT* inY, const SHORT* deadZoneRadius, SHORT* outX, SHORT* outY, std::size_t count );
+	static InstructionSet	getBestInstructionSet();
+
+	static InstructionSet	mInstructionSet;
+	static const char*		mInstructionSetNames[InstructionSet_Count];
+};
+
+}
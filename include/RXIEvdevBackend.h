@@ -0,0 +1,115 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXIBackend.h"
+
+#include <mutex>
+#include <vector>
+
+namespace RXI
+{
+
+/*
+	EvdevBackend
+	A Linux Backend reading the controllers from evdev input devices 
+	(/dev/input/event*). Only available on Linux.
+
+	Rather than polling the devices at a fixed interval, the client code calls 
+	waitForEvents() which sleeps (using epoll) until one of the devices reports 
+	something. The struct input_event records read from the device are accumulated 
+	and a new state (with a new packet number) is published on each SYN_REPORT. 
+	The indices of the controllers that changed are returned so that the client 
+	code only updates these ones through ControllerManager::updateController():
+
+		std::vector<DWORD> changedControllers;
+		while ( backend.waitForEvents( -1, &changedControllers )>=0 )
+			for ( std::size_t i=0; i<changedControllers.size(); ++i )
+				manager.updateController( changedControllers[i] );
+
+	Devices are attached to a controller slot either by path (openDevice), in which
+	case the axis ranges and force-feedback support are queried from the device, 
+	or by any readable file descriptor (addDevice) carrying input_event records, 
+	such as a pipe or a socket. A device is detached when its file descriptor 
+	reaches end-of-file or reports an error.
+	
+	The buttons and axes are mapped following the Linux xpad driver conventions.
+
+	All the methods are thread-safe: the devices can be read by waitForEvents() 
+	on one thread while a BatteryPoller or a ControllerDiscovery queries them from 
+	another one. waitForEvents() doesn't hold the lock while it sleeps.
+*/
+class EvdevBackend : public Backend
+{
+public:
+	EvdevBackend( DWORD numMaxControllers=XUSER_MAX_COUNT );
+	virtual ~EvdevBackend();
+
+	virtual DWORD	getMaxNumControllers() const			{ return static_cast<DWORD>( mDevices.size() ); }
+
+	// Opens the device at the given path (/dev/input/eventX) and attaches it to the 
+	// first free controller slot. Returns the controller index or -1 on failure
+	int				openDevice( const char* path );
+	
+	// Opens all the /dev/input/event* devices that look like gamepads. 
+	// Returns the number of devices opened
+	int				openDevices();
+
+	// Attaches an already opened file descriptor to the given controller slot.
+	// The file descriptor is switched to non-blocking mode. It is closed by the 
+	// backend on removal only if takeOwnership is true
+	bool			addDevice( DWORD controllerIndex, int fd, bool takeOwnership=false );
+	void			removeDevice( DWORD controllerIndex );
+	bool			hasDevice( DWORD controllerIndex ) const;
+
+	// Waits for at most timeoutInMs (-1 for infinity) until at least one device 
+	// has something to report, reads everything available and returns the number of 
+	// controllers that changed (state published, device added or removed). Their 
+	// indices are stored in changedControllerIndices if provided. Returns -1 on error.
+	int				waitForEvents( int timeoutInMs, std::vector<DWORD>* changedControllerIndices=NULL );
+
+	virtual DWORD	getState( DWORD controllerIndex, XINPUT_STATE* state );
+	virtual DWORD	getCapabilities( DWORD controllerIndex, DWORD flags, XINPUT_CAPABILITIES* capabilities );
+	virtual DWORD	setState( DWORD controllerIndex, XINPUT_VIBRATION* vibration );
+	virtual DWORD	getBatteryInformation( DWORD controllerIndex, BYTE devType, XINPUT_BATTERY_INFORMATION* batteryInformation );
+	virtual bool	isThreadSafe() const					{ return true; }
+
+private:
+	struct Device;
+
+	bool			attachDevice( DWORD controllerIndex, int fd, bool takeOwnership );
+	void			detachDevice( DWORD controllerIndex );
+	Device*			getConnectedDevice( DWORD controllerIndex ) const;
+	bool			readDevice( DWORD controllerIndex );
+	void			processEvent( Device& device, unsigned short type, unsigned short code, int value );
+	void			resynchronizeDevice( Device& device );
+	void			notifyChange( DWORD controllerIndex );
+
+	mutable std::mutex		mMutex;						// Protects the devices and mChangedControllerIndices
+	int						mEpollFd;
+	std::vector<Device*>	mDevices;
+	std::vector<DWORD>		mChangedControllerIndices;
+};
+
+}
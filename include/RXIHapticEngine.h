@@ -0,0 +1,174 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXIXInput.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RXI
+{
+
+/*
+	HapticEffect
+	The description of a vibration effect, played by a HapticEngine. The effect 
+	is the product of three terms, evaluated for each motor:
+	- a magnitude, going linearly from startMagnitude to endMagnitude over the 
+	  duration of the effect (a ramp, or a constant force when they're equal)
+	- a waveform, between 0 and 1, repeating every periodInMs
+	- an envelope: the effect rises from attackLevel to full strength during 
+	  attackTimeInMs, and decays to fadeLevel during the last fadeTimeInMs
+
+	The magnitudes are between 0 and 1. An effect with a null duration plays 
+	until it's stopped (it can't have a ramp or a fade then).
+*/
+struct HapticEffect
+{
+	enum Waveform
+	{
+		Waveform_Constant,
+		Waveform_Sine,
+		Waveform_Square,
+		Waveform_Triangle,
+		Waveform_SawtoothUp,
+		Waveform_SawtoothDown,
+		Waveform_Count
+	};
+
+	HapticEffect();
+
+	// Evaluates the speed of both motors (left and right), between 0 and 1, at the 
+	// given time since the start of the effect. Returns false once the effect is over.
+	// The time is kept in integer nanoseconds so that the waveform of an effect 
+	// playing for hours doesn't lose its precision
+	bool			evaluate( unsigned long long int timeInNs, float speeds[2] ) const;
+
+	// A few ready-made effects
+	static HapticEffect	constant( float leftMagnitude, float rightMagnitude, unsigned int durationInMs );
+	static HapticEffect	ramp( float startMagnitude, float endMagnitude, unsigned int durationInMs );
+	static HapticEffect	periodic( Waveform waveform, float magnitude, unsigned int periodInMs, unsigned int durationInMs );
+
+	Waveform		waveform;
+	unsigned int	periodInMs;
+	unsigned int	durationInMs;
+	float			startMagnitude[2];
+	float			endMagnitude[2];
+	unsigned int	attackTimeInMs;
+	float			attackLevel;
+	unsigned int	fadeTimeInMs;
+	float			fadeLevel;
+};
+
+/*
+	HapticEngine
+	Plays HapticEffects on a dedicated thread. At a fixed rate (250 Hz by default) 
+	the thread evaluates the effects playing on each controller, adds them up 
+	(effects can be layered), and stages the resulting motor speeds. 
+
+	The ControllerManager the engine is attached to (see ControllerManager::setHapticEngine()) 
+	applies the staged speeds during its update, through Controller::setVibration(): 
+	getVibrationMotorSpeed(), the listeners, the vibration coalescing and the 
+	InputRecorder see them as any other vibration. Both motors are written at once 
+	and only when their speeds change. The staged speeds are read without locking, 
+	so the update never waits for the engine thread.
+
+	The game only starts and stops effects, from any thread: the effects no longer 
+	depend on the frame rate, only the writes to the device do. While effects are 
+	playing on a controller they override the speeds set through 
+	Controller::setVibrationMotorSpeed(). Once they're over, the motors are stopped 
+	and left to the game.
+*/
+class HapticEngine
+{
+public:
+	HapticEngine( DWORD numMaxControllers, unsigned int frequencyInHz=250 );
+	virtual ~HapticEngine();
+
+	DWORD				getMaxNumControllers() const			{ return mNumMaxControllers; }
+	unsigned int		getFrequencyInHz() const				{ return mFrequencyInHz; }
+
+	bool				start();
+	void				stop();
+	bool				isRunning() const						{ return mThread.joinable(); }
+
+	// Starts playing an effect on a controller and returns its identifier, 
+	// or 0 on failure
+	typedef unsigned int EffectID;
+	EffectID			play( DWORD controllerIndex, const HapticEffect& effect );
+	bool				stopEffect( EffectID effectID );
+	void				stopAllEffects( DWORD controllerIndex );
+	bool				isPlaying( EffectID effectID ) const;
+	std::size_t			getNumPlayingEffects() const;
+
+	// Evaluates the effects and stages the motor speeds. Called by the engine thread 
+	// at the engine frequency, it can also be called directly when the engine 
+	// isn't started (to drive it from an existing timer for example)
+	void				tick();
+
+	// The motor speeds staged for a controller by the last tick. Returns false (and 
+	// null speeds) when no effect is playing on it. Can be called from any thread
+	bool				getVibration( DWORD controllerIndex, XINPUT_VIBRATION& vibration ) const;
+
+	unsigned long long	getNumTicks() const						{ return mNumTicks.load(); }
+
+private:
+	HapticEngine( const HapticEngine& );
+	HapticEngine& operator=( const HapticEngine& );
+
+	void				run();
+
+	struct PlayingEffect
+	{
+		EffectID				effectID;
+		DWORD					controllerIndex;
+		unsigned long long int	startTimeInNs;
+		HapticEffect			effect;
+	};
+	
+	DWORD							mNumMaxControllers;
+	unsigned int					mFrequencyInHz;
+	std::thread						mThread;
+	std::atomic<bool>				mStopRequested;
+	std::atomic<unsigned long long>	mNumTicks;
+
+	// Shared with the engine thread
+	mutable std::mutex				mMutex;
+	std::vector<PlayingEffect>		mPlayingEffects;
+	EffectID						mNextEffectID;
+
+	// Engine thread only
+	std::vector<float>				mSpeeds;				// Two per controller
+	std::vector<bool>				mHasEffects;
+
+	// Written by the engine thread, read by the thread updating the ControllerManager: 
+	// the speeds of the left and right motors in the low 32 bits, and whether effects 
+	// are playing in the next one
+	std::vector< std::atomic<unsigned long long int> > mStagedVibrations;
+	static const unsigned long long int mPlayingFlag = 1ULL << 32;
+};
+
+}
@@ -0,0 +1,134 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXIInputRecorder.h"
+
+#include <vector>
+
+namespace RXI
+{
+
+/*
+	InputEncoder
+	Compresses the records of an InputRecorder into self-contained blocks. 
+
+	Controller states change sparsely, so rather than a full snapshot, a state 
+	record stores what changed since the previous state of its controller: the 
+	gap between the packet numbers, the flipped button bits, the new trigger 
+	values and the thumbstick differences. The integers are varint-encoded, the 
+	signed ones zigzag-encoded first. A typical state packet takes 6 to 12 bytes 
+	instead of 32, mostly for its timestamp.
+
+	The capabilities of a connection and the battery information are rarely 
+	recorded, they're stored as they are.
+
+	Each block starts with a keyframe: the connection status, the last state, 
+	the capabilities and the battery information of every controller seen so far. 
+	A block can be decoded on its own and gives the state of all the controllers 
+	at its start.
+
+	Block layout:
+		BlockHeader
+		keyframe:	varint number of controllers, then for each of them a varint 
+					controller index, a flags byte, its state (as a delta from zero), 
+					its capabilities and its battery information
+		records:	a tag byte (type in the low 3 bits, controller index in the 
+					high 5 bits, or 31 followed by a varint), the zigzag varint 
+					timestamp difference with the previous record, then the payload
+		padding:	mBlockPadding zero bytes
+*/
+class InputEncoder
+{
+public:
+	typedef InputRecorder::Record Record;
+
+	struct BlockHeader
+	{
+		unsigned int			size;					// Of the whole block in bytes, header and padding included
+		unsigned int			numRecords;
+		unsigned long long int	firstTimestampInNs;
+		unsigned long long int	lastTimestampInNs;
+	};
+
+	struct ControllerState
+	{
+		ControllerState();
+
+		bool					isConnected;
+		XINPUT_STATE			state;					// The last state packet received since the connection
+		XINPUT_CAPABILITIES		capabilities;			// Those it got connected with
+		XINPUT_BATTERY_INFORMATION batteryInformation[2];	// The last recorded, indexed by BATTERY_DEVTYPE_GAMEPAD/BATTERY_DEVTYPE_HEADSET
+	};
+
+	// The padding lets the decoder check the bounds once per record rather than 
+	// once per byte: it's more than a record can make it read, even corrupted
+	static const std::size_t	mBlockPadding = 96;
+
+	InputEncoder();
+
+	// Forgets about the controllers: the next keyframe is empty
+	void				reset();
+
+	// Encodes the records into block, replacing its content
+	void				encodeBlock( const Record* records, std::size_t numRecords, std::vector<unsigned char>& block );
+
+	// The state of the controllers after the records encoded so far
+	const std::vector<ControllerState>& getControllerStates() const		{ return mControllerStates; }
+
+private:
+	std::vector<ControllerState> mControllerStates;			// Indexed by controller index
+};
+
+/*
+	InputDecoder
+	Decodes the blocks produced by an InputEncoder. 
+
+	The blocks are independent: they can be decoded in any order, or in parallel 
+	with one decoder per thread.
+*/
+class InputDecoder
+{
+public:
+	typedef InputRecorder::Record Record;
+
+	InputDecoder();
+
+	// Reads the header of the block at the start of data. Returns false if the 
+	// size bytes available don't hold a whole block (a truncated file for example)
+	static bool			getBlockHeader( const unsigned char* data, std::size_t size, InputEncoder::BlockHeader& header );
+
+	// Decodes a whole block. records must have room for the numRecords of its header. 
+	// Returns false if the block is corrupted
+	bool				decodeBlock( const unsigned char* block, std::size_t size, Record* records );
+
+	// The state of the controllers at the start of the last decoded block
+	const std::vector<InputEncoder::ControllerState>& getKeyframe() const	{ return mKeyframe; }
+
+private:
+	std::vector<InputEncoder::ControllerState> mKeyframe;
+	std::vector<XINPUT_STATE> mStates;						// While decoding, indexed by controller index
+};
+
+}
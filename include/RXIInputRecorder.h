@@ -0,0 +1,236 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXIXInput.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+namespace RXI
+{
+
+class InputEncoder;
+
+/*
+	InputRecorder
+	Records what the Controllers see into a binary log file: every new state 
+	packet of each controller (with its nanosecond timestamp), the connections 
+	(with the capabilities of the controller), the disconnections, the changes 
+	of battery information and the vibration motor speeds written to them. 
+
+	The file is a FileHeader followed by fixed-size Records, in the order they 
+	were recorded. It's memory-mapped and grown by large chunks: appending a 
+	record is a bounds check and a 32-byte copy, cheap enough to capture hours 
+	of play at 1 kHz on the game thread. The records are written to disk by the 
+	operating system, flush() and close() only force it.
+
+	The number of records in the header is only written when the file grows, by 
+	flush() and by close(). If the application crashes, the readers find the end 
+	of the log at the first record of type RecordType_None (the unused part of 
+	the file is zero-filled).
+
+	The log can also be compressed as it's recorded (see openCompressed() and 
+	InputEncoder). The records are then gathered in memory and written to the 
+	file a block at a time, each block costing a few microseconds to encode. 
+	A compressed log is typically 3 to 5 times smaller. If the application 
+	crashes, the records of the last block are lost.
+
+	When a compressed log is closed, a table of its blocks (BlockIndexEntry) is 
+	appended to the file. The readers use it to jump to any time of the log 
+	without reading it all. If the log wasn't closed, they rebuild it from the 
+	block headers.
+
+	The timestamps of the records never decrease: a record given an earlier 
+	timestamp than the previous one (a state read by a Sampler before a vibration 
+	was written for example) gets the timestamp of the previous one instead. 
+	The readers rely on it to binary-search the log.
+
+	The recorder is attached to a ControllerManager (see ControllerManager::setRecorder()) 
+	and used from the thread updating it. 
+*/
+class InputRecorder
+{
+public:
+	enum RecordType
+	{
+		RecordType_None,				// Marks the end of the log
+		RecordType_State,				// A new state packet, in gamepad
+		RecordType_Connection,			// The controller got connected, with the capabilities in device and capabilities
+		RecordType_Disconnection,		// The controller got disconnected, no payload
+		RecordType_Vibration,			// The motor speeds written to the controller, in vibration
+		RecordType_Battery,				// The battery information changed, in batteryInformation
+		RecordType_Count
+	};
+
+	// The capabilities of a connection are those of its XINPUT_CAPABILITIES, split 
+	// between device and capabilities. Whatever a record type doesn't use is zero
+	struct Record
+	{
+		unsigned long long int	timestampInNs;		// See Timestamp
+		union
+		{
+			DWORD				packetNumber;		// For RecordType_State
+			struct
+			{
+				BYTE			type;
+				BYTE			subType;
+				WORD			flags;
+			}					device;				// For RecordType_Connection
+		};
+		WORD					controllerIndex;
+		BYTE					type;				// A RecordType
+		BYTE					reserved;
+		union
+		{
+			XINPUT_GAMEPAD		gamepad;			// For RecordType_State
+			XINPUT_VIBRATION	vibration;			// For RecordType_Vibration
+			struct
+			{
+				XINPUT_GAMEPAD	gamepad;
+				XINPUT_VIBRATION vibration;
+			}					capabilities;		// For RecordType_Connection
+			XINPUT_BATTERY_INFORMATION batteryInformation[2];	// For RecordType_Battery, indexed by BATTERY_DEVTYPE_GAMEPAD/BATTERY_DEVTYPE_HEADSET
+		};
+	};
+
+	struct FileHeader
+	{
+		char					magic[8];			// "RXIREC\0\0"
+		unsigned int			version;
+		unsigned int			recordSize;			// sizeof(Record)
+		unsigned long long int	numRecords;			// Up to date after flush() or close() only
+		unsigned long long int	blockIndexOffset;	// Of the block table of a compressed log, 0 until it's closed
+		unsigned long long int	numBlocks;			// In that table
+		unsigned long long int	reserved[3];
+	};
+
+	struct BlockIndexEntry
+	{
+		unsigned long long int	offset;				// Of the block in the file
+		unsigned long long int	firstRecordIndex;
+		unsigned long long int	firstTimestampInNs;
+		unsigned long long int	lastTimestampInNs;
+	};
+
+	static const unsigned int	mVersion = 2;
+
+	InputRecorder();
+	virtual ~InputRecorder();
+
+	// Creates the file, replacing any existing one. The file grows by chunks of that many records
+	bool				open( const char* filename, std::size_t chunkSizeInRecords=1<<20 );
+
+	// Creates a compressed file, replacing any existing one. A block with its keyframe is written every that many records
+	bool				openCompressed( const char* filename, std::size_t keyframeIntervalInRecords=4096 );
+
+	void				close();
+	bool				isOpen() const								{ return mMapping!=NULL || mCompressedFile!=NULL; }
+	bool				isCompressed() const						{ return mCompressedFile!=NULL; }
+	void				flush();
+
+	void				recordState( DWORD controllerIndex, unsigned long long int timestampInNs, const XINPUT_STATE& state );
+	void				recordConnection( DWORD controllerIndex, unsigned long long int timestampInNs, const XINPUT_CAPABILITIES& capabilities );
+	void				recordDisconnection( DWORD controllerIndex, unsigned long long int timestampInNs );
+	void				recordVibration( DWORD controllerIndex, unsigned long long int timestampInNs, const XINPUT_VIBRATION& vibration );
+	void				recordBattery( DWORD controllerIndex, unsigned long long int timestampInNs, const XINPUT_BATTERY_INFORMATION batteryInformation[2] );
+
+	// The capabilities a RecordType_Connection record holds
+	static void			getCapabilities( const Record& record, XINPUT_CAPABILITIES& capabilities );
+	static void			setCapabilities( Record& record, const XINPUT_CAPABILITIES& capabilities );
+
+	unsigned long long	getNumRecords() const						{ return mNumRecords; }
+
+	// The records lost because the file couldn't grow (disk full for example). Growing isn't 
+	// retried after a failure: the records that don't fit anymore are all dropped
+	unsigned long long	getNumDroppedRecords() const				{ return mNumDroppedRecords; }
+
+private:
+	InputRecorder( const InputRecorder& );
+	InputRecorder& operator=( const InputRecorder& );
+
+	Record*				appendRecord( BYTE type, DWORD controllerIndex, unsigned long long int timestampInNs );
+	bool				grow();
+	bool				writeBlock();
+	void				writeCompressedFileHeader( unsigned long long int blockIndexOffset );
+	void				writeBlockIndex();
+	bool				map( unsigned long long int fileSize );
+	void				unmap();
+	unsigned long long int getFileSize( std::size_t capacityInRecords ) const	{ return sizeof(FileHeader) + capacityInRecords*sizeof(Record); }
+
+#ifdef _WIN32
+	void*				mFile;
+	void*				mFileMapping;
+#else
+	int					mFile;
+#endif
+	void*				mMapping;
+	std::FILE*			mCompressedFile;
+	InputEncoder*		mEncoder;
+	std::vector<Record>	mBlockRecords;
+	std::vector<unsigned char> mBlock;
+	std::vector<BlockIndexEntry> mBlockIndex;
+	unsigned long long	mCompressedFileSize;
+	bool				mIsBlockWriteFailed;
+	bool				mIsGrowFailed;
+	Record*				mRecords;
+	std::size_t			mNumBufferedRecords;		// In mRecords: all of them when memory-mapped, those of the current block when compressed
+	std::size_t			mCapacityInRecords;
+	std::size_t			mChunkSizeInRecords;
+	unsigned long long	mNumRecords;
+	unsigned long long	mNumDroppedRecords;
+	unsigned long long	mLastTimestampInNs;			// Of the last record
+};
+
+inline InputRecorder::Record* InputRecorder::appendRecord( BYTE type, DWORD controllerIndex, unsigned long long int timestampInNs )
+{
+	if ( mNumBufferedRecords>=mCapacityInRecords && !grow() )
+	{
+		++mNumDroppedRecords;
+		return NULL;
+	}
+	Record* record = &mRecords[mNumBufferedRecords++];
+	++mNumRecords;
+	if ( timestampInNs>mLastTimestampInNs )
+		mLastTimestampInNs = timestampInNs;
+	record->timestampInNs = mLastTimestampInNs;
+	record->packetNumber = 0;
+	record->controllerIndex = static_cast<WORD>( controllerIndex );
+	record->type = type;
+	record->reserved = 0;
+	ZeroMemory( &record->capabilities, sizeof(record->capabilities) );
+	return record;
+}
+
+inline void InputRecorder::recordState( DWORD controllerIndex, unsigned long long int timestampInNs, const XINPUT_STATE& state )
+{
+	Record* record = appendRecord( RecordType_State, controllerIndex, timestampInNs );
+	if ( !record )
+		return;
+	record->packetNumber = state.dwPacketNumber;
+	record->gamepad = state.Gamepad;
+}
+
+}
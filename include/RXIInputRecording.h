@@ -0,0 +1,133 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXIInputRecorder.h"
+#include "RXIInputCodec.h"
+
+#include <vector>
+
+namespace RXI
+{
+
+/*
+	InputRecording
+	Read-only access to a log written by an InputRecorder. The file is 
+	memory-mapped, the records of a plain log are accessed in place. Those of a 
+	compressed log are decoded a block at a time, when one of them is accessed: 
+	the log is meant to be read in order, or from the records found by findRecord().
+
+	The number of records is taken from the file header. For a log that was 
+	never closed (the application crashed), the header of a plain log only counts 
+	the records of the last grow or flush: the log is read on up to the first record 
+	of type RecordType_None. A compressed log is read up to its first incomplete block.
+
+	findRecord() finds the record at a given time with a binary search, assuming 
+	the timestamps increase. In a compressed log, it searches the block table 
+	then the records of one block. getControllerStates() gives the state of all 
+	the controllers at a record: from the keyframe of its block in a compressed 
+	log. A plain log has no keyframes: they're made in memory every 
+	mKeyframeIntervalInRecords records, as far as getControllerStates() has gone, 
+	so only the first call that goes that far reads the log up to there. 
+
+	An InputRecording isn't thread-safe, even when it's const: each thread reading 
+	a log should open its own.
+*/
+class InputRecording
+{
+public:
+	typedef InputRecorder::Record Record;
+	typedef InputEncoder::ControllerState ControllerState;
+
+	InputRecording();
+	virtual ~InputRecording();
+
+	bool				open( const char* filename );
+	void				close();
+	bool				isOpen() const								{ return mMapping!=NULL; }
+	bool				isCompressed() const						{ return mIsCompressed; }
+
+	std::size_t			getNumRecords() const						{ return mNumRecords; }
+	
+	// With a compressed log, the reference is valid until a record of another block is accessed
+	const Record&		getRecord( std::size_t index ) const;
+
+	// The index of the first record at or after that time, getNumRecords() if there's none
+	std::size_t			findRecord( unsigned long long int timestampInNs ) const;
+
+	// The state of the controllers just before that record, indexed by controller index
+	void				getControllerStates( std::size_t index, std::vector<ControllerState>& controllerStates ) const;
+
+	// The time span of the recording
+	unsigned long long int getStartTimestampInNs() const;
+	unsigned long long int getEndTimestampInNs() const;
+
+	// The blocks of a compressed log
+	const std::vector<InputRecorder::BlockIndexEntry>& getBlockIndex() const		{ return mBlockIndex; }
+
+	// The interval of the keyframes made for a plain log, the default one of a compressed log
+	static const std::size_t	mKeyframeIntervalInRecords = 4096;
+
+private:
+	InputRecording( const InputRecording& );
+	InputRecording& operator=( const InputRecording& );
+
+	bool				readBlockIndex();
+	void				buildBlockIndex();
+	std::size_t			findBlock( std::size_t index ) const;
+	void				loadBlock( std::size_t blockIndex ) const;
+	void				applyRecords( std::size_t firstIndex, std::size_t endIndex, std::vector<ControllerState>& controllerStates ) const;
+
+#ifdef _WIN32
+	void*				mFile;
+	void*				mFileMapping;
+#endif
+	void*				mMapping;
+	std::size_t			mMappingSize;
+	bool				mIsCompressed;
+	std::size_t			mNumRecords;
+	std::vector<InputRecorder::BlockIndexEntry> mBlockIndex;
+
+	// The records at hand: all of them in a plain log, those of the last block 
+	// decoded in a compressed log
+	mutable const Record* mRecords;
+	mutable std::size_t	mFirstRecordIndex;
+	mutable std::size_t	mNumLoadedRecords;
+	mutable std::size_t	mLoadedBlockIndex;
+	mutable std::vector<Record> mDecodedRecords;
+	mutable InputDecoder mDecoder;
+
+	// The states of the controllers before every mKeyframeIntervalInRecords-th record of a plain log, 
+	// made by getControllerStates()
+	mutable std::vector< std::vector<ControllerState> > mKeyframes;
+};
+
+inline const InputRecording::Record& InputRecording::getRecord( std::size_t index ) const
+{
+	if ( index-mFirstRecordIndex>=mNumLoadedRecords )
+		loadBlock( findBlock( index ) );
+	return mRecords[index-mFirstRecordIndex];
+}
+
+}
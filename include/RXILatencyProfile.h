@@ -0,0 +1,123 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXITimestamp.h"
+
+namespace RXI
+{
+
+/*
+	LatencyHistogram
+	Records durations in nanoseconds with a bounded relative error, in the manner 
+	of an HDR histogram: values below 32 ns are counted exactly, larger ones fall 
+	into one of the 32 sub-buckets of their power of two (about 3% precision). 
+	Recording is constant-time and never allocates. Durations longer than about 
+	4 seconds are counted in the last bucket.
+
+	It isn't thread-safe: it must be read from the thread that records into it.
+*/
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void					record( unsigned long long int durationInNs );
+	void					reset();
+
+	unsigned long long int	getCount() const				{ return mCount; }
+	unsigned long long int	getMinInNs() const				{ return mCount>0 ? mMinInNs : 0; }
+	unsigned long long int	getMaxInNs() const				{ return mMaxInNs; }
+	double					getMeanInNs() const				{ return mCount>0 ? static_cast<double>(mSumInNs)/static_cast<double>(mCount) : 0; }
+	
+	// Returns the value below which the given percentage of the recorded durations fall 
+	// (50 for the median, 99.9 for the p999). The value is the upper bound of the bucket
+	unsigned long long int	getPercentileInNs( double percentile ) const;
+
+private:
+	enum 
+	{ 
+		NumSubBucketBits = 5,
+		NumSubBuckets = 1<<NumSubBucketBits,
+		NumBuckets = (32-NumSubBucketBits+1)*NumSubBuckets
+	};
+	static unsigned int		getBucketIndex( unsigned int value );
+	static unsigned long long int getBucketUpperBound( unsigned int bucketIndex );
+
+	unsigned long long int	mCounts[NumBuckets];
+	unsigned long long int	mCount;
+	unsigned long long int	mSumInNs;
+	unsigned long long int	mMinInNs;
+	unsigned long long int	mMaxInNs;
+};
+
+/*
+	LatencyProfile
+	One LatencyHistogram per stage of the update path. The ControllerManager owns 
+	one and its Controllers record into it:
+	- poll: reading the state of a controller from the Backend
+	- diff: processing a packet in Controller::update, without the dead zones and 
+	  the listeners
+	- dead zone: applying the dead zone of a thumbstick (or of all of them, with 
+	  batch processing)
+	- dispatch: calling the listeners of a change (or of a batch of changes)
+	- packet to listener: from the moment the packet was read from the device to 
+	  the moment its change reaches the listeners
+
+	The measurements are only made when the library is compiled with 
+	RXI_ENABLE_LATENCY_PROFILING (the RAPAXINPUT_LATENCY_PROFILING CMake option). 
+	Otherwise, they are compiled out and the histograms remain empty. Each measurement 
+	reads the clock twice, which is part of what the diff stage reports.
+*/
+class LatencyProfile
+{
+public:
+	enum Stage
+	{
+		Stage_Poll,
+		Stage_Diff,
+		Stage_DeadZone,
+		Stage_Dispatch,
+		Stage_PacketToListener,
+		Stage_Count
+	};
+
+	LatencyProfile() {}
+
+	static bool					isEnabled();
+	static const char*			getStageName( Stage stage )						{ return mStageNames[stage]; }
+
+	const LatencyHistogram&		getHistogram( Stage stage ) const				{ return mHistograms[stage]; }
+	void						reset();
+
+	// Records the time elapsed since startTimeInNs and returns it
+	unsigned long long int		record( Stage stage, unsigned long long int startTimeInNs );
+	void						recordDuration( Stage stage, unsigned long long int durationInNs )	{ mHistograms[stage].record( durationInNs ); }
+
+private:
+	static const char*			mStageNames[Stage_Count];
+	LatencyHistogram			mHistograms[Stage_Count];
+};
+
+}
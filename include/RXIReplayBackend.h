@@ -0,0 +1,115 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXISyntheticBackend.h"
+#include "RXIInputRecording.h"
+
+namespace RXI
+{
+
+class ControllerManager;
+
+/*
+	ReplayBackend
+	Plays a session recorded by an InputRecorder back into a ControllerManager.
+
+	The recorded state packets, connections and disconnections are fed to 
+	ControllerManager::updateController() with their original timestamps, and 
+	the recorded battery changes to ControllerManager::updateControllerBattery(), 
+	so the Controllers go through the exact same changes and the Listeners receive 
+	the exact same calls as during the recorded session. A BatchListener may get a 
+	battery change in a batch of its own rather than with the state packet of the 
+	same update. The recorded vibrations are skipped: they were the output of the 
+	application, not its input.
+
+	replay() feeds the records whose time has come, according to the time scale: 
+	1 replays with the original timing, 100 a hundred times faster, and 0 as fast 
+	as possible (all the remaining records at once). It's meant to be called 
+	regularly from the thread updating the ControllerManager, in place of 
+	ControllerManager::update().
+
+	It's also the Backend of that ControllerManager. The replayed controllers are 
+	connected to the underlying SyntheticBackend with their recorded capabilities, 
+	and given their recorded battery information, so that capabilities queries, 
+	battery queries and vibrations behave as with real devices, and getState() 
+	returns the last replayed packet. The battery queries the Controllers make on 
+	their own find the last replayed battery information, so they change nothing. 
+	The manager must use synchronous connection (see 
+	ControllerManager::setAsynchronousConnectionEnabled()) for the replay to be 
+	deterministic.
+
+	seek() jumps to any time of the recording: the controllers are connected, 
+	disconnected and updated to their state at that time, as if they had been 
+	unplugged and plugged back or moved very fast, and the replay carries on from 
+	there. With a compressed recording, it only decodes one block.
+*/
+class ReplayBackend : public SyntheticBackend
+{
+public:
+	ReplayBackend( DWORD numMaxControllers=XUSER_MAX_COUNT );
+	virtual ~ReplayBackend();
+
+	bool					open( const char* filename );
+	void					close();
+	const InputRecording&	getRecording() const						{ return mRecording; }
+
+	// 1 for the original timing, 0 for as fast as possible
+	void					setTimeScale( double timeScale );
+	double					getTimeScale() const						{ return mTimeScale; }
+
+	// Restarts from the beginning of the recording. The replayed controllers are 
+	// disconnected from the backend, the next ControllerManager::update() disconnects them
+	void					rewind();
+
+	// Jumps to a time of the recording (see InputRecording::getStartTimestampInNs()). 
+	// Returns the index of the next record to replay
+	std::size_t				seek( ControllerManager& manager, unsigned long long int timestampInNs );
+
+	// Returns the number of records replayed
+	std::size_t				replay( ControllerManager& manager );
+	std::size_t				replayAll( ControllerManager& manager );
+
+	bool					isFinished() const							{ return mNextRecordIndex>=mRecording.getNumRecords(); }
+	std::size_t				getNextRecordIndex() const					{ return mNextRecordIndex; }
+
+	virtual DWORD			getState( DWORD controllerIndex, XINPUT_STATE* state );
+
+private:
+	std::size_t				replayUntil( ControllerManager& manager, unsigned long long int timestampInNs );
+	void					replayRecord( ControllerManager& manager, const InputRecording::Record& record );
+	unsigned long long int	getReplayedTimestampInNs( unsigned long long int timeInNs ) const;
+
+	InputRecording			mRecording;
+	std::size_t				mNextRecordIndex;
+	double					mTimeScale;
+	bool					mIsStarted;
+	unsigned long long int	mStartTimeInNs;					// When replay() started, in Timestamp time
+	unsigned long long int	mStartReplayedTimestampInNs;	// The recorded time replayed at mStartTimeInNs
+	
+	std::mutex				mStatesMutex;
+	std::vector<XINPUT_STATE> mStates;						// The last replayed packet of each slot
+};
+
+}
@@ -0,0 +1,123 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace RXI
+{
+
+/*
+	RingBuffer
+	A bounded single-producer/single-consumer queue. 
+	
+	push() must only be called by one thread (the producer) and pop() by one other 
+	thread (the consumer). Both are wait-free: they never block nor spin, and simply 
+	return false when the buffer is respectively full or empty.
+
+	The capacity is rounded up to the next power of two. The read and write indices 
+	live on separate cache lines, and each side keeps a cached copy of the other 
+	side's index so the shared cache lines are only touched when needed.
+*/
+template <typename T>
+class RingBuffer
+{
+public:
+	explicit RingBuffer( std::size_t capacity )
+		:	mItems(),
+			mMask(0),
+			mWriteIndex(0),
+			mCachedReadIndex(0),
+			mReadIndex(0),
+			mCachedWriteIndex(0)
+	{
+		std::size_t size = 1;
+		while ( size<capacity )
+			size <<= 1;
+		mItems.resize( size );
+		mMask = size - 1;
+	}
+
+	std::size_t		getCapacity() const		{ return mItems.size(); }
+
+	// Producer side. Returns false if the buffer is full
+	bool push( const T& item )
+	{
+		std::size_t writeIndex = mWriteIndex.load( std::memory_order_relaxed );
+		if ( writeIndex - mCachedReadIndex>=mItems.size() )
+		{
+			mCachedReadIndex = mReadIndex.load( std::memory_order_acquire );
+			if ( writeIndex - mCachedReadIndex>=mItems.size() )
+				return false;
+		}
+		mItems[writeIndex & mMask] = item;
+		mWriteIndex.store( writeIndex + 1, std::memory_order_release );
+		return true;
+	}
+
+	// Consumer side. Returns false if the buffer is empty
+	bool pop( T& item )
+	{
+		std::size_t readIndex = mReadIndex.load( std::memory_order_relaxed );
+		if ( readIndex==mCachedWriteIndex )
+		{
+			mCachedWriteIndex = mWriteIndex.load( std::memory_order_acquire );
+			if ( readIndex==mCachedWriteIndex )
+				return false;
+		}
+		item = mItems[readIndex & mMask];
+		mReadIndex.store( readIndex + 1, std::memory_order_release );
+		return true;
+	}
+
+	// Approximate number of items in the buffer (exact when called from either side while the other is idle)
+	std::size_t getSize() const
+	{
+		return mWriteIndex.load( std::memory_order_acquire ) - mReadIndex.load( std::memory_order_acquire );
+	}
+
+private:
+	RingBuffer( const RingBuffer& );
+	RingBuffer& operator=( const RingBuffer& );
+
+	static const std::size_t mCacheLineSize = 64;
+
+	std::vector<T>				mItems;
+	std::size_t					mMask;
+	char						mPadding0[mCacheLineSize];
+
+	// Producer side
+	std::atomic<std::size_t>	mWriteIndex;
+	std::size_t					mCachedReadIndex;
+	char						mPadding1[mCacheLineSize];
+
+	// Consumer side
+	std::atomic<std::size_t>	mReadIndex;
+	std::size_t					mCachedWriteIndex;
+	char						mPadding2[mCacheLineSize];
+};
+
+}
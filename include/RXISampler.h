@@ -0,0 +1,122 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXIXInput.h"
+#include "RXIRingBuffer.h"
+
+#include <atomic>
+#include <thread>
+
+namespace RXI
+{
+
+class Backend;
+class ControllerManager;
+
+/*
+	Sampler
+	An optional background thread that polls a Backend at a fixed rate (1 kHz 
+	by default), independently of the rate at which the client code updates 
+	the ControllerManager.
+
+	Every change it observes (new packet, connection, disconnection) is published 
+	as a timestamped Sample through a wait-free single-producer/single-consumer 
+	RingBuffer. The consumer thread (typically the game thread) drains the samples 
+	once per frame and applies them in order to the ControllerManager, so that 
+	presses and releases happening between two frames are not lost:
+
+		RXI::Sampler sampler( manager.getBackend(), manager.getMaxNumControllers() );
+		sampler.start();
+		...
+		// Once per frame, instead of manager.update()
+		sampler.drain( manager );
+
+	The sampler only reads the state of the controllers. The Backend must therefore 
+	support getState() being called from the sampler thread while the other methods 
+	are called from the consumer thread: the sampler doesn't start unless 
+	Backend::isThreadSafe(). The XInput, synthetic and evdev backends are.
+
+	Empty slots are probed less often (every enumerationIntervalInMs), as recommended
+	for XInput. If the consumer doesn't drain the samples fast enough and the buffer 
+	gets full, new samples are dropped and counted.
+*/
+class Sampler
+{
+public:
+	struct Sample
+	{
+		unsigned long long int timestampInNs;	// When the state was read (see Timestamp)
+		DWORD			controllerIndex;
+		bool			connected;
+		XINPUT_STATE	state;				// Only meaningful when connected
+	};
+
+	Sampler( Backend* backend, DWORD numMaxControllers, unsigned int frequencyInHz=1000, std::size_t capacity=4096 );
+	virtual ~Sampler();
+
+	unsigned int		getFrequencyInHz() const				{ return mFrequencyInHz; }
+	
+	// To be called before start()
+	void				setEnumerationIntervalInMs( unsigned int intervalInMs )	{ mEnumerationIntervalInMs = intervalInMs; }
+	unsigned int		getEnumerationIntervalInMs() const		{ return mEnumerationIntervalInMs; }
+
+	bool				start();
+	void				stop();
+	bool				isRunning() const						{ return mThread.joinable(); }
+
+	// Consumer side. Pops the oldest sample, returns false if there's none
+	bool				popSample( Sample& sample )				{ return mSamples.pop( sample ); }
+	
+	// Consumer side. Applies all the available samples (at most maxNumSamples) to the 
+	// manager, in order, then lets it complete its asynchronous connections. Returns the 
+	// number of samples applied
+	std::size_t			drain( ControllerManager& manager, std::size_t maxNumSamples=static_cast<std::size_t>(-1) );
+
+	unsigned long long	getNumPolls() const						{ return mNumPolls.load(); }
+	unsigned long long	getNumDroppedSamples() const			{ return mNumDroppedSamples.load(); }
+
+private:
+	Sampler( const Sampler& );
+	Sampler& operator=( const Sampler& );
+
+	void				run();
+	void				poll( bool enumerateControllers );
+
+	Backend*						mBackend;
+	DWORD							mNumMaxControllers;
+	unsigned int					mFrequencyInHz;
+	unsigned int					mEnumerationIntervalInMs;
+	RingBuffer<Sample>				mSamples;
+	std::thread						mThread;
+	std::atomic<bool>				mStopRequested;
+	std::atomic<unsigned long long>	mNumPolls;
+	std::atomic<unsigned long long>	mNumDroppedSamples;
+
+	// Sampler thread only: what has been published so far for each slot
+	std::vector<bool>				mConnected;
+	std::vector<DWORD>				mLastPacketNumbers;
+};
+
+}
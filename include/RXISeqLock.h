@@ -0,0 +1,102 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+namespace RXI
+{
+
+/*
+	SeqLock
+	Publishes a value written by a single thread to any number of reader threads 
+	without locks. 
+	
+	The writer increments a sequence counter before and after modifying the value 
+	(the counter is odd while a write is in progress). A reader copies the value and 
+	retries if the counter was odd or changed in the meantime. Readers never block 
+	the writer and never see a torn value.
+
+	The value is stored as an array of atomic words so that concurrent accesses are 
+	well-defined. T must therefore be trivially copyable and is best kept small.
+*/
+template <typename T>
+class SeqLock
+{
+public:
+	SeqLock()
+		:	mSequence(0)
+	{
+		for ( std::size_t i=0; i<mNumWords; ++i )
+			mWords[i].store( 0, std::memory_order_relaxed );
+	}
+
+	// Writer side. Must only be called by one thread at a time
+	void store( const T& value )
+	{
+		unsigned int words[mNumWords] = {0};
+		memcpy( words, &value, sizeof(T) );
+
+		unsigned int sequence = mSequence.load( std::memory_order_relaxed );
+		mSequence.store( sequence + 1, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_release );
+		for ( std::size_t i=0; i<mNumWords; ++i )
+			mWords[i].store( words[i], std::memory_order_relaxed );
+		mSequence.store( sequence + 2, std::memory_order_release );
+	}
+
+	// Reader side. Can be called by any number of threads concurrently
+	void load( T& value ) const
+	{
+		unsigned int words[mNumWords];
+		unsigned int sequenceBefore = 0;
+		unsigned int sequenceAfter = 0;
+		do
+		{
+			sequenceBefore = mSequence.load( std::memory_order_acquire );
+			for ( std::size_t i=0; i<mNumWords; ++i )
+				words[i] = mWords[i].load( std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_acquire );
+			sequenceAfter = mSequence.load( std::memory_order_relaxed );
+		}
+		while ( (sequenceBefore & 1)!=0 || sequenceBefore!=sequenceAfter );
+		memcpy( &value, words, sizeof(T) );
+	}
+
+	// The number of values published so far
+	unsigned int getVersion() const		{ return mSequence.load( std::memory_order_acquire ) / 2; }
+
+private:
+	SeqLock( const SeqLock& );
+	SeqLock& operator=( const SeqLock& );
+
+	static const std::size_t		mNumWords = ( sizeof(T) + sizeof(unsigned int) - 1 ) / sizeof(unsigned int);
+
+	std::atomic<unsigned int>		mSequence;
+	std::atomic<unsigned int>		mWords[mNumWords];
+};
+
+}
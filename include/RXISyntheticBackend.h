@@ -0,0 +1,104 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXIBackend.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace RXI
+{
+
+/*
+	SyntheticBackend
+	A Backend that keeps the state of a set of simulated controllers in memory.
+
+	The client code decides which controllers are connected, what their 
+	capabilities are, and feeds them new gamepad states. Each new gamepad state 
+	increments the packet number of the controller, as the real XInput does.
+	The vibration motor speeds set by the ControllerManager can be read back.
+
+	It works on any platform and is meant for testing, load-testing and 
+	benchmarking the library without physical devices. All the methods are 
+	thread-safe, so the simulated controllers can be driven from one thread 
+	while a Sampler polls them from another one.
+*/
+class SyntheticBackend : public Backend
+{
+public:
+	SyntheticBackend( DWORD numMaxControllers=XUSER_MAX_COUNT );
+	virtual ~SyntheticBackend();
+
+	virtual DWORD	getMaxNumControllers() const						{ return static_cast<DWORD>( mSlots.size() ); }
+
+	// Connect a controller with default capabilities: a gamepad with all its buttons, 
+	// triggers, thumbsticks and motors, and a wired connection (no battery)
+	void			connectController( DWORD controllerIndex );
+	void			connectController( DWORD controllerIndex, const XINPUT_CAPABILITIES& capabilities );
+	void			disconnectController( DWORD controllerIndex );
+	bool			isControllerConnected( DWORD controllerIndex ) const;
+
+	void			setGamepad( DWORD controllerIndex, const XINPUT_GAMEPAD& gamepad );
+	void			setBatteryInformation( DWORD controllerIndex, BYTE devType, const XINPUT_BATTERY_INFORMATION& batteryInformation );
+	bool			getVibration( DWORD controllerIndex, XINPUT_VIBRATION& vibration ) const;
+
+	// Makes getCapabilities() and getBatteryInformation() take that long, as real 
+	// driver queries can. The other methods aren't slowed down meanwhile
+	void			setDeviceQueryLatencyInUs( unsigned int latencyInUs )	{ mDeviceQueryLatencyInUs = latencyInUs; }
+
+	// Makes getState() take that long on an empty slot, as probing an empty slot 
+	// is expensive with XInput
+	void			setEmptySlotLatencyInUs( unsigned int latencyInUs )	{ mEmptySlotLatencyInUs = latencyInUs; }
+
+	static void		getDefaultCapabilities( XINPUT_CAPABILITIES& capabilities );
+
+	virtual DWORD	getState( DWORD controllerIndex, XINPUT_STATE* state );
+	virtual DWORD	getCapabilities( DWORD controllerIndex, DWORD flags, XINPUT_CAPABILITIES* capabilities );
+	virtual DWORD	setState( DWORD controllerIndex, XINPUT_VIBRATION* vibration );
+	virtual DWORD	getBatteryInformation( DWORD controllerIndex, BYTE devType, XINPUT_BATTERY_INFORMATION* batteryInformation );
+	virtual bool	isThreadSafe() const								{ return true; }
+
+private:
+	struct Slot
+	{
+		bool						connected;
+		XINPUT_CAPABILITIES			capabilities;
+		XINPUT_STATE				state;
+		XINPUT_VIBRATION			vibration;
+		XINPUT_BATTERY_INFORMATION	batteryInformation[2];		// Indexed by BATTERY_DEVTYPE_GAMEPAD/BATTERY_DEVTYPE_HEADSET
+	};
+
+	Slot*			getConnectedSlot( DWORD controllerIndex );
+	static void		simulateLatency( unsigned int latencyInUs );
+	void			resetSlot( Slot& slot );
+
+	mutable std::mutex	mMutex;
+	std::vector<Slot>	mSlots;
+	std::atomic<unsigned int> mDeviceQueryLatencyInUs;
+	std::atomic<unsigned int> mEmptySlotLatencyInUs;
+};
+
+}
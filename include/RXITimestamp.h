@@ -26,11 +26,17 @@
 namespace RXI
 {
 
+/*
+	Timestamp
+	A monotonic clock (QueryPerformanceCounter on Windows, CLOCK_MONOTONIC elsewhere) 
+	whose time origin is the start of the application. Timestamps are 64-bit, so they 
+	don't wrap around in practice.
+*/
 class Timestamp
 {
 public:
-	// Returns a timestamp in milliseconds. The time origin is the start of the application
-	static unsigned int				getTimestampInMs();
+	static unsigned long long int	getTimestampInNs();
+	static unsigned long long int	getTimestampInMs()			{ return getTimestampInNs() / 1000000ULL; }
 
 private:
 	Timestamp();
@@ -0,0 +1,71 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+/*
+	Basic Windows types used throughout the library (DWORD, WORD, BYTE, SHORT, GUID...)
+	On Windows they come from windows.h. On other platforms, we define the 
+	equivalent types ourselves so the library can be compiled and used with
+	a non-XInput Backend.
+*/
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN 
+#define NOMINMAX 
+#include <windows.h>
+
+#else
+
+#include <string.h>
+
+typedef unsigned int	DWORD;		// 32 bits as on Windows (unsigned long is 64 bits on LP64 platforms)
+typedef unsigned short	WORD;
+typedef unsigned char	BYTE;
+typedef short			SHORT;
+typedef unsigned int	UINT;
+typedef wchar_t			WCHAR;
+
+struct GUID
+{
+	unsigned int	Data1;
+	unsigned short	Data2;
+	unsigned short	Data3;
+	unsigned char	Data4[8];
+};
+
+#ifndef ZeroMemory
+	#define ZeroMemory(destination, length) memset((destination), 0, (length))
+#endif
+
+#ifndef ERROR_SUCCESS
+	#define ERROR_SUCCESS					0L
+#endif
+#ifndef ERROR_BAD_ARGUMENTS
+	#define ERROR_BAD_ARGUMENTS				160L
+#endif
+#ifndef ERROR_DEVICE_NOT_CONNECTED
+	#define ERROR_DEVICE_NOT_CONNECTED		1167L
+#endif
+
+#endif
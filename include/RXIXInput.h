@@ -0,0 +1,158 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXITypes.h"
+
+/*
+	XInput types and constants
+	On Windows, this simply includes the XInput header from the SDK and works out 
+	which version of the API we're compiling against. 
+	
+	On other platforms, XInput is not available. We define here the subset of 
+	XInput 1.4 types and constants that the library relies on, so that Controller 
+	and ControllerManager can be driven by a non-XInput Backend.
+*/
+#ifdef _WIN32
+
+// XInput must be included after windows.h
+#include <XInput.h>
+
+// Create a define corresponding to the version of XInput (none is officially provided!)
+// Here is some information about XInput versions:
+// http://msdn.microsoft.com/en-us/library/windows/desktop/hh405051(v=vs.85).aspx
+#ifdef XINPUT_DEVSUBTYPE_WHEEL					// Exists only since XInput 1.3 
+	#ifdef XINPUT_DEVSUBTYPE_GUITAR_ALTERNATE	// Exists only since XInput 1.4
+		#define _XINPUT_1_4
+	#else
+		#define _XINPUT_1_3
+	#endif
+#else
+	#define _XINPUT_9_1_0
+#endif
+
+#else
+
+// We behave as XInput 1.4 which is the most complete version of the API
+#define _XINPUT_1_4
+
+// Device types and sub-types
+#define XINPUT_DEVTYPE_GAMEPAD				0x01
+#define XINPUT_DEVSUBTYPE_UNKNOWN			0x00
+#define XINPUT_DEVSUBTYPE_GAMEPAD			0x01
+#define XINPUT_DEVSUBTYPE_WHEEL				0x02
+#define XINPUT_DEVSUBTYPE_ARCADE_STICK		0x03
+#define XINPUT_DEVSUBTYPE_FLIGHT_STICK		0x04
+#define XINPUT_DEVSUBTYPE_DANCE_PAD			0x05
+#define XINPUT_DEVSUBTYPE_GUITAR			0x06
+#define XINPUT_DEVSUBTYPE_GUITAR_ALTERNATE	0x07
+#define XINPUT_DEVSUBTYPE_DRUM_KIT			0x08
+#define XINPUT_DEVSUBTYPE_GUITAR_BASS		0x0B
+#define XINPUT_DEVSUBTYPE_ARCADE_PAD		0x13
+
+// Capability flags
+#define XINPUT_CAPS_FFB_SUPPORTED			0x0001
+#define XINPUT_CAPS_WIRELESS				0x0002
+#define XINPUT_CAPS_VOICE_SUPPORTED			0x0004
+#define XINPUT_CAPS_PMD_SUPPORTED			0x0008
+#define XINPUT_CAPS_NO_NAVIGATION			0x0010
+
+// Button bit-masks
+#define XINPUT_GAMEPAD_DPAD_UP				0x0001
+#define XINPUT_GAMEPAD_DPAD_DOWN			0x0002
+#define XINPUT_GAMEPAD_DPAD_LEFT			0x0004
+#define XINPUT_GAMEPAD_DPAD_RIGHT			0x0008
+#define XINPUT_GAMEPAD_START				0x0010
+#define XINPUT_GAMEPAD_BACK					0x0020
+#define XINPUT_GAMEPAD_LEFT_THUMB			0x0040
+#define XINPUT_GAMEPAD_RIGHT_THUMB			0x0080
+#define XINPUT_GAMEPAD_LEFT_SHOULDER		0x0100
+#define XINPUT_GAMEPAD_RIGHT_SHOULDER		0x0200
+#define XINPUT_GAMEPAD_A					0x1000
+#define XINPUT_GAMEPAD_B					0x2000
+#define XINPUT_GAMEPAD_X					0x4000
+#define XINPUT_GAMEPAD_Y					0x8000
+
+// Default dead zones
+#define XINPUT_GAMEPAD_LEFT_THUMB_DEADZONE	7849
+#define XINPUT_GAMEPAD_RIGHT_THUMB_DEADZONE	8689
+#define XINPUT_GAMEPAD_TRIGGER_THRESHOLD	30
+
+// Flags for XInputGetCapabilities
+#define XINPUT_FLAG_GAMEPAD					0x00000001
+
+// Battery devices, types and levels
+#define BATTERY_DEVTYPE_GAMEPAD				0x00
+#define BATTERY_DEVTYPE_HEADSET				0x01
+#define BATTERY_TYPE_DISCONNECTED			0x00
+#define BATTERY_TYPE_WIRED					0x01
+#define BATTERY_TYPE_ALKALINE				0x02
+#define BATTERY_TYPE_NIMH					0x03
+#define BATTERY_TYPE_UNKNOWN				0xFF
+#define BATTERY_LEVEL_EMPTY					0x00
+#define BATTERY_LEVEL_LOW					0x01
+#define BATTERY_LEVEL_MEDIUM				0x02
+#define BATTERY_LEVEL_FULL					0x03
+
+#define XUSER_MAX_COUNT						4
+
+struct XINPUT_GAMEPAD
+{
+	WORD	wButtons;
+	BYTE	bLeftTrigger;
+	BYTE	bRightTrigger;
+	SHORT	sThumbLX;
+	SHORT	sThumbLY;
+	SHORT	sThumbRX;
+	SHORT	sThumbRY;
+};
+
+struct XINPUT_STATE
+{
+	DWORD			dwPacketNumber;
+	XINPUT_GAMEPAD	Gamepad;
+};
+
+struct XINPUT_VIBRATION
+{
+	WORD	wLeftMotorSpeed;
+	WORD	wRightMotorSpeed;
+};
+
+struct XINPUT_CAPABILITIES
+{
+	BYTE				Type;
+	BYTE				SubType;
+	WORD				Flags;
+	XINPUT_GAMEPAD		Gamepad;
+	XINPUT_VIBRATION	Vibration;
+};
+
+struct XINPUT_BATTERY_INFORMATION
+{
+	BYTE	BatteryType;
+	BYTE	BatteryLevel;
+};
+
+#endif
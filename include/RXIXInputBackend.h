@@ -0,0 +1,47 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#pragma once
+
+#include "RXIBackend.h"
+
+namespace RXI
+{
+
+/*
+	XInputBackend
+	The Backend that talks to the actual devices through the Microsoft XInput API.
+	Only available on Windows.
+*/
+class XInputBackend : public Backend
+{
+public:
+	virtual DWORD	getMaxNumControllers() const;
+	virtual DWORD	getState( DWORD controllerIndex, XINPUT_STATE* state );
+	virtual DWORD	getCapabilities( DWORD controllerIndex, DWORD flags, XINPUT_CAPABILITIES* capabilities );
+	virtual DWORD	setState( DWORD controllerIndex, XINPUT_VIBRATION* vibration );
+	virtual DWORD	getBatteryInformation( DWORD controllerIndex, BYTE devType, XINPUT_BATTERY_INFORMATION* batteryInformation );
+	virtual bool	isThreadSafe() const							{ return true; }		// The XInput functions are
+};
+
+}
@@ -0,0 +1,691 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXIController.h"
+#include "RXIInputRecording.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+	Reports statistics about recorded sessions (see InputRecorder): how often 
+	each button is pressed and how long it's held, where the triggers and the 
+	thumbsticks are, how often their dead zone filters a position out, and how 
+	often the controllers send new state packets.
+
+	The sessions are split into chunks analyzed in parallel, one worker thread 
+	per core. A compressed log is split at the boundaries of its blocks: the 
+	state of the controllers at the start of a chunk comes from the keyframe of 
+	its first block. A plain log has no keyframes: the worker reads the state at 
+	the start of its chunk from the log, up to there (see 
+	InputRecording::getControllerStates()). So a plain log is only split when 
+	there are fewer sessions than workers, otherwise each worker takes whole 
+	sessions. The results of the chunks are then merged in order: the button 
+	holds and the packet intervals spanning two chunks are completed then. 
+	A session that fails to open is left out of the report, and the exit code is 1.
+
+	Usage: RapaXInputAnalyzer [--threads n] [--chunk records] [--check] file...
+		--threads	the number of worker threads, the number of cores by default
+		--chunk		the number of records of a chunk, 262144 by default
+		--check		also analyzes the sessions with other numbers of threads and 
+					chunk sizes, and exits with 1 if a result differs
+*/
+
+using RXI::Controller;
+using RXI::InputRecorder;
+using RXI::InputRecording;
+
+static const unsigned int numHistogramBuckets = 16;
+
+// The upper bounds of the buckets of the hold durations and the packet intervals
+static const unsigned long long int holdDurationBucketsInMs[] = { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, ~0ULL };
+static const unsigned int numHoldDurationBuckets = sizeof(holdDurationBucketsInMs) / sizeof(holdDurationBucketsInMs[0]);
+static const unsigned long long int packetIntervalBucketsInUs[] = { 1000, 2000, 4000, 8000, 16000, 32000, 64000, ~0ULL };
+static const unsigned int numPacketIntervalBuckets = sizeof(packetIntervalBucketsInUs) / sizeof(packetIntervalBucketsInUs[0]);
+
+static unsigned int getBucket( const unsigned long long int* upperBounds, unsigned long long int value )
+{
+	unsigned int bucket = 0;
+	while ( value>=upperBounds[bucket] )
+		++bucket;
+	return bucket;
+}
+
+/*
+	Statistics
+	What's counted over any part of the sessions. Merging two of them gives the 
+	statistics of both parts.
+*/
+struct Statistics
+{
+	Statistics()
+	{
+		memset( this, 0, sizeof(Statistics) );
+		minPacketIntervalInNs = ~0ULL;
+	}
+
+	void merge( const Statistics& other )
+	{
+		numSessions += other.numSessions;
+		recordedTimeInNs += other.recordedTimeInNs;
+		numRecords += other.numRecords;
+		numStates += other.numStates;
+		numConnections += other.numConnections;
+		numDisconnections += other.numDisconnections;
+		numVibrations += other.numVibrations;
+		numBatteryChanges += other.numBatteryChanges;
+		for ( int i=0; i<Controller::Button_Count; ++i )
+		{
+			numPresses[i] += other.numPresses[i];
+			numHolds[i] += other.numHolds[i];
+			holdDurationInNs[i] += other.holdDurationInNs[i];
+			maxHoldDurationInNs[i] = std::max( maxHoldDurationInNs[i], other.maxHoldDurationInNs[i] );
+		}
+		for ( unsigned int i=0; i<numHoldDurationBuckets; ++i )
+			holdDurationHistogram[i] += other.holdDurationHistogram[i];
+		for ( int i=0; i<Controller::Trigger_Count; ++i )
+		{
+			for ( unsigned int j=0; j<numHistogramBuckets; ++j )
+				triggerHistogram[i][j] += other.triggerHistogram[i][j];
+			numTriggerDeadZoneHits[i] += other.numTriggerDeadZoneHits[i];
+		}
+		for ( int i=0; i<Controller::Thumbstick_Count; ++i )
+		{
+			for ( unsigned int j=0; j<numHistogramBuckets; ++j )
+				thumbstickHistogram[i][j] += other.thumbstickHistogram[i][j];
+			numThumbstickDeadZoneHits[i] += other.numThumbstickDeadZoneHits[i];
+		}
+		numPacketIntervals += other.numPacketIntervals;
+		packetIntervalSumInNs += other.packetIntervalSumInNs;
+		minPacketIntervalInNs = std::min( minPacketIntervalInNs, other.minPacketIntervalInNs );
+		maxPacketIntervalInNs = std::max( maxPacketIntervalInNs, other.maxPacketIntervalInNs );
+		for ( unsigned int i=0; i<numPacketIntervalBuckets; ++i )
+			packetIntervalHistogram[i] += other.packetIntervalHistogram[i];
+	}
+
+	void addHold( int buttonID, unsigned long long int durationInNs )
+	{
+		++numHolds[buttonID];
+		holdDurationInNs[buttonID] += durationInNs;
+		maxHoldDurationInNs[buttonID] = std::max( maxHoldDurationInNs[buttonID], durationInNs );
+		++holdDurationHistogram[ getBucket( holdDurationBucketsInMs, durationInNs/1000000 ) ];
+	}
+
+	void addPacketInterval( unsigned long long int intervalInNs )
+	{
+		++numPacketIntervals;
+		packetIntervalSumInNs += intervalInNs;
+		minPacketIntervalInNs = std::min( minPacketIntervalInNs, intervalInNs );
+		maxPacketIntervalInNs = std::max( maxPacketIntervalInNs, intervalInNs );
+		++packetIntervalHistogram[ getBucket( packetIntervalBucketsInUs, intervalInNs/1000 ) ];
+	}
+
+	unsigned long long int	numSessions;
+	unsigned long long int	recordedTimeInNs;
+	unsigned long long int	numRecords;
+	unsigned long long int	numStates;
+	unsigned long long int	numConnections;
+	unsigned long long int	numDisconnections;
+	unsigned long long int	numVibrations;
+	unsigned long long int	numBatteryChanges;
+
+	unsigned long long int	numPresses[Controller::Button_Count];
+	unsigned long long int	numHolds[Controller::Button_Count];				// The presses released during the sessions
+	unsigned long long int	holdDurationInNs[Controller::Button_Count];
+	unsigned long long int	maxHoldDurationInNs[Controller::Button_Count];
+	unsigned long long int	holdDurationHistogram[numHoldDurationBuckets];
+
+	// By position (thumbstick distance from the center), for every state packet
+	unsigned long long int	triggerHistogram[Controller::Trigger_Count][numHistogramBuckets];
+	unsigned long long int	thumbstickHistogram[Controller::Thumbstick_Count][numHistogramBuckets];
+
+	// The state packets where a non-zero position is inside the default dead zone
+	unsigned long long int	numTriggerDeadZoneHits[Controller::Trigger_Count];
+	unsigned long long int	numThumbstickDeadZoneHits[Controller::Thumbstick_Count];
+
+	// Between two state packets of a controller
+	unsigned long long int	numPacketIntervals;
+	unsigned long long int	packetIntervalSumInNs;
+	unsigned long long int	minPacketIntervalInNs;
+	unsigned long long int	maxPacketIntervalInNs;
+	unsigned long long int	packetIntervalHistogram[numPacketIntervalBuckets];
+};
+
+/*
+	Chunk
+	A range of records of a session, and what its analysis gives. Besides the 
+	statistics, a chunk keeps what it can't complete on its own: the button holds 
+	and packet intervals that started in the chunks before it, and those that 
+	carry on in the chunks after it.
+*/
+struct ButtonEdge
+{
+	DWORD					controllerIndex;
+	int						buttonID;
+	unsigned long long int	timestampInNs;
+};
+
+struct ControllerEdge
+{
+	DWORD					controllerIndex;
+	bool					hasFirstState;				// The first state packet of the controller in the chunk, before any (dis)connection
+	unsigned long long int	firstStateTimestampInNs;
+	bool					hasLastState;				// The last one, after any (dis)connection
+	unsigned long long int	lastStateTimestampInNs;
+};
+
+struct Chunk
+{
+	std::size_t					sessionIndex;
+	std::size_t					firstRecordIndex;
+	std::size_t					endRecordIndex;
+	bool						isFailed;					// The session failed to open for the chunk
+	
+	Statistics					statistics;					// With the session counted in the first chunk of the session
+	std::vector<ButtonEdge>		releasesOfEarlierPresses;	// Buttons pressed at the start of the chunk, released in it
+	std::vector<ButtonEdge>		unreleasedPresses;			// Buttons pressed in the chunk, still pressed at its end
+	std::vector<ControllerEdge>	controllerEdges;			// Of the controllers with records in the chunk
+};
+
+/*
+	ChunkAnalyzer
+	Goes through the records of a chunk, following the state of each controller.
+*/
+class ChunkAnalyzer
+{
+public:
+	ChunkAnalyzer( Chunk& chunk ) : mChunk( chunk ), mControllers() {}
+
+	void analyze( const InputRecording& recording )
+	{
+		std::vector<InputRecording::ControllerState> controllerStates;
+		recording.getControllerStates( mChunk.firstRecordIndex, controllerStates );
+		mControllers.resize( controllerStates.size() );
+		for ( std::size_t i=0; i<controllerStates.size(); ++i )
+		{
+			mControllers[i].isConnected = controllerStates[i].isConnected;
+			mControllers[i].gamepad = controllerStates[i].state.Gamepad;
+		}
+
+		Statistics& statistics = mChunk.statistics;
+		for ( std::size_t i=mChunk.firstRecordIndex; i<mChunk.endRecordIndex; ++i )
+		{
+			InputRecorder::Record record = recording.getRecord( i );
+			++statistics.numRecords;
+			if ( record.controllerIndex>=mControllers.size() )
+				mControllers.resize( record.controllerIndex+1 );
+			switch ( record.type )
+			{
+				case InputRecorder::RecordType_State:
+					analyzeState( record );
+					break;
+				case InputRecorder::RecordType_Connection:
+					++statistics.numConnections;
+					resetController( record );
+					mControllers[record.controllerIndex].isConnected = true;
+					break;
+				case InputRecorder::RecordType_Disconnection:
+					++statistics.numDisconnections;
+					resetController( record );
+					mControllers[record.controllerIndex].isConnected = false;
+					break;
+				case InputRecorder::RecordType_Vibration:
+					++statistics.numVibrations;
+					break;
+				case InputRecorder::RecordType_Battery:
+					++statistics.numBatteryChanges;
+					break;
+			}
+		}
+
+		// What the next chunks complete
+		for ( std::size_t i=0; i<mControllers.size(); ++i )
+		{
+			const ControllerAnalysis& controller = mControllers[i];
+			for ( int buttonID=0; buttonID<Controller::Button_Count; ++buttonID )
+			{
+				if ( controller.pressesInChunk & Controller::getButtonXInputID( static_cast<Controller::ButtonID>(buttonID) ) )
+				{
+					ButtonEdge edge = { static_cast<DWORD>(i), buttonID, controller.pressTimestampInNs[buttonID] };
+					mChunk.unreleasedPresses.push_back( edge );
+				}
+			}
+			if ( controller.hasRecords )
+			{
+				ControllerEdge edge = { static_cast<DWORD>(i), controller.hasFirstState, controller.firstStateTimestampInNs, controller.hasLastState, controller.lastStateTimestampInNs };
+				mChunk.controllerEdges.push_back( edge );
+			}
+		}
+	}
+
+private:
+	struct ControllerAnalysis
+	{
+		ControllerAnalysis()
+			:	isConnected(false), 
+				pressesInChunk(0), 
+				hasRecords(false), 
+				hasFirstState(false), 
+				firstStateTimestampInNs(0), 
+				hasLastState(false), 
+				lastStateTimestampInNs(0)
+		{
+			ZeroMemory( &gamepad, sizeof(XINPUT_GAMEPAD) );
+			memset( pressTimestampInNs, 0, sizeof(pressTimestampInNs) );
+		}
+
+		bool					isConnected;
+		XINPUT_GAMEPAD			gamepad;
+		WORD					pressesInChunk;			// The pressed buttons whose press is in the chunk
+		unsigned long long int	pressTimestampInNs[Controller::Button_Count];
+		bool					hasRecords;
+		bool					hasFirstState;
+		unsigned long long int	firstStateTimestampInNs;
+		bool					hasLastState;
+		unsigned long long int	lastStateTimestampInNs;
+	};
+
+	void analyzeState( const InputRecorder::Record& record )
+	{
+		Statistics& statistics = mChunk.statistics;
+		ControllerAnalysis& controller = mControllers[record.controllerIndex];
+		const XINPUT_GAMEPAD& gamepad = record.gamepad;
+		++statistics.numStates;
+
+		// Packet rate
+		if ( controller.hasLastState )
+			statistics.addPacketInterval( record.timestampInNs - controller.lastStateTimestampInNs );
+		else if ( !controller.hasRecords )
+		{
+			controller.hasFirstState = true;
+			controller.firstStateTimestampInNs = record.timestampInNs;
+		}
+		controller.hasRecords = true;
+		controller.hasLastState = true;
+		controller.lastStateTimestampInNs = record.timestampInNs;
+
+		// Buttons
+		WORD changedButtons = gamepad.wButtons ^ controller.gamepad.wButtons;
+		if ( changedButtons )
+		{
+			for ( int buttonID=0; buttonID<Controller::Button_Count; ++buttonID )
+			{
+				WORD button = Controller::getButtonXInputID( static_cast<Controller::ButtonID>(buttonID) );
+				if ( !(changedButtons & button) )
+					continue;
+				if ( gamepad.wButtons & button )
+				{
+					++statistics.numPresses[buttonID];
+					controller.pressesInChunk |= button;
+					controller.pressTimestampInNs[buttonID] = record.timestampInNs;
+				}
+				else
+				{
+					releaseButton( record.controllerIndex, buttonID, record.timestampInNs );
+				}
+			}
+		}
+
+		// Triggers and thumbsticks
+		const BYTE triggerPositions[Controller::Trigger_Count] = { gamepad.bLeftTrigger, gamepad.bRightTrigger };
+		for ( int i=0; i<Controller::Trigger_Count; ++i )
+		{
+			++statistics.triggerHistogram[i][ triggerPositions[i] * numHistogramBuckets / 256 ];
+			if ( triggerPositions[i]>0 && triggerPositions[i]<=XINPUT_GAMEPAD_TRIGGER_THRESHOLD )
+				++statistics.numTriggerDeadZoneHits[i];
+		}
+		const int thumbstickPositions[Controller::Thumbstick_Count][2] = { { gamepad.sThumbLX, gamepad.sThumbLY }, { gamepad.sThumbRX, gamepad.sThumbRY } };
+		const int deadZoneRadius[Controller::Thumbstick_Count] = { XINPUT_GAMEPAD_LEFT_THUMB_DEADZONE, XINPUT_GAMEPAD_RIGHT_THUMB_DEADZONE };
+		for ( int i=0; i<Controller::Thumbstick_Count; ++i )
+		{
+			long long int x = thumbstickPositions[i][0];
+			long long int y = thumbstickPositions[i][1];
+			long long int squaredDistance = x*x + y*y;
+			long long int squaredDeadZoneRadius = static_cast<long long int>( deadZoneRadius[i] ) * deadZoneRadius[i];
+			unsigned int bucket = 0;
+			while ( bucket+1<numHistogramBuckets && squaredDistance>=static_cast<long long int>( (bucket+1)*32768/numHistogramBuckets ) * ( (bucket+1)*32768/numHistogramBuckets ) )
+				++bucket;
+			++statistics.thumbstickHistogram[i][bucket];
+			if ( squaredDistance>0 && squaredDistance<=squaredDeadZoneRadius )
+				++statistics.numThumbstickDeadZoneHits[i];
+		}
+
+		controller.gamepad = gamepad;
+	}
+
+	// A (dis)connection releases all the buttons, and interrupts the packet intervals
+	void resetController( const InputRecorder::Record& record )
+	{
+		ControllerAnalysis& controller = mControllers[record.controllerIndex];
+		for ( int buttonID=0; buttonID<Controller::Button_Count; ++buttonID )
+		{
+			if ( controller.gamepad.wButtons & Controller::getButtonXInputID( static_cast<Controller::ButtonID>(buttonID) ) )
+				releaseButton( record.controllerIndex, buttonID, record.timestampInNs );
+		}
+		ZeroMemory( &controller.gamepad, sizeof(XINPUT_GAMEPAD) );
+		controller.hasRecords = true;
+		controller.hasLastState = false;
+	}
+
+	void releaseButton( DWORD controllerIndex, int buttonID, unsigned long long int timestampInNs )
+	{
+		ControllerAnalysis& controller = mControllers[controllerIndex];
+		WORD button = Controller::getButtonXInputID( static_cast<Controller::ButtonID>(buttonID) );
+		if ( controller.pressesInChunk & button )
+		{
+			mChunk.statistics.addHold( buttonID, timestampInNs - controller.pressTimestampInNs[buttonID] );
+			controller.pressesInChunk &= ~button;
+		}
+		else
+		{
+			ButtonEdge edge = { controllerIndex, buttonID, timestampInNs };
+			mChunk.releasesOfEarlierPresses.push_back( edge );
+		}
+	}
+
+	Chunk&							mChunk;
+	std::vector<ControllerAnalysis> mControllers;
+};
+
+// Splits the sessions into chunks of about that many records, at block boundaries in a compressed log, 
+// only when there are fewer sessions than threads in a plain log. Returns false if a session failed to open
+static bool makeChunks( const std::vector<std::string>& filenames, std::size_t chunkSizeInRecords, unsigned int numThreads, std::vector<Chunk>& chunks )
+{
+	bool isOpened = true;
+	for ( std::size_t i=0; i<filenames.size(); ++i )
+	{
+		InputRecording recording;
+		if ( !recording.open( filenames[i].c_str() ) )
+		{
+			fprintf( stderr, "Failed to open %s\n", filenames[i].c_str() );
+			isOpened = false;
+			continue;
+		}
+
+		std::vector<std::size_t> firstRecordIndices( 1, 0 );
+		const std::vector<InputRecorder::BlockIndexEntry>& blockIndex = recording.getBlockIndex();
+		if ( recording.isCompressed() )
+		{
+			for ( std::size_t j=1; j<blockIndex.size(); ++j )
+			{
+				std::size_t blockRecordIndex = static_cast<std::size_t>( blockIndex[j].firstRecordIndex );
+				if ( blockRecordIndex-firstRecordIndices.back()>=chunkSizeInRecords )
+					firstRecordIndices.push_back( blockRecordIndex );
+			}
+		}
+		else if ( filenames.size()<numThreads )
+		{
+			for ( std::size_t j=chunkSizeInRecords; j<recording.getNumRecords(); j+=chunkSizeInRecords )
+				firstRecordIndices.push_back( j );
+		}
+
+		for ( std::size_t j=0; j<firstRecordIndices.size(); ++j )
+		{
+			chunks.push_back( Chunk() );
+			Chunk& chunk = chunks.back();
+			chunk.sessionIndex = i;
+			chunk.firstRecordIndex = firstRecordIndices[j];
+			chunk.endRecordIndex = j+1<firstRecordIndices.size() ? firstRecordIndices[j+1] : recording.getNumRecords();
+			chunk.isFailed = false;
+			if ( j==0 )
+			{
+				chunk.statistics.numSessions = 1;
+				chunk.statistics.recordedTimeInNs = recording.getEndTimestampInNs() - recording.getStartTimestampInNs();
+			}
+		}
+	}
+	return isOpened;
+}
+
+static void analyzeChunks( const std::vector<std::string>& filenames, std::vector<Chunk>& chunks, unsigned int numThreads )
+{
+	std::atomic<std::size_t> nextChunkIndex( 0 );
+	std::vector<std::thread> threads;
+	for ( unsigned int i=0; i<numThreads; ++i )
+	{
+		threads.push_back( std::thread( [&]()
+			{
+				// Each thread reads the sessions on its own. It gets the chunks of a session 
+				// in order, so it reads a plain log at most once to find where they start
+				InputRecording recording;
+				std::size_t sessionIndex = filenames.size();
+				for ( std::size_t chunkIndex=nextChunkIndex++; chunkIndex<chunks.size(); chunkIndex=nextChunkIndex++ )
+				{
+					Chunk& chunk = chunks[chunkIndex];
+					if ( chunk.sessionIndex!=sessionIndex )
+					{
+						recording.close();
+						sessionIndex = chunk.sessionIndex;
+						if ( !recording.open( filenames[sessionIndex].c_str() ) )
+							fprintf( stderr, "Failed to open %s again\n", filenames[sessionIndex].c_str() );
+					}
+					if ( !recording.isOpen() )
+					{
+						chunk.isFailed = true;
+						continue;
+					}
+					ChunkAnalyzer analyzer( chunk );
+					analyzer.analyze( recording );
+				}
+			} ) );
+	}
+	for ( std::size_t i=0; i<threads.size(); ++i )
+		threads[i].join();
+}
+
+// Merges the statistics of the chunks, in order, completing what spans several of them.
+// Leaves out the sessions with a failed chunk, and returns false if there's one
+static bool mergeChunks( const std::vector<Chunk>& chunks, Statistics& statistics )
+{
+	std::vector<bool> isSessionFailed;
+	for ( std::size_t i=0; i<chunks.size(); ++i )
+	{
+		if ( chunks[i].sessionIndex>=isSessionFailed.size() )
+			isSessionFailed.resize( chunks[i].sessionIndex+1, false );
+		if ( chunks[i].isFailed )
+			isSessionFailed[chunks[i].sessionIndex] = true;
+	}
+
+	bool isMerged = true;
+	std::map<std::pair<DWORD, int>, unsigned long long int> pressTimestamps;		// Of the buttons pressed in the previous chunks of the session
+	std::map<DWORD, unsigned long long int> lastStateTimestamps;					// Of the controllers in the previous chunks of the session
+	for ( std::size_t i=0; i<chunks.size(); ++i )
+	{
+		const Chunk& chunk = chunks[i];
+		if ( isSessionFailed[chunk.sessionIndex] )
+		{
+			isMerged = false;
+			continue;
+		}
+		if ( i==0 || chunk.sessionIndex!=chunks[i-1].sessionIndex )
+		{
+			// The presses unreleased at the end of a session aren't counted as holds
+			pressTimestamps.clear();
+			lastStateTimestamps.clear();
+		}
+		statistics.merge( chunk.statistics );
+
+		for ( std::size_t j=0; j<chunk.releasesOfEarlierPresses.size(); ++j )
+		{
+			const ButtonEdge& edge = chunk.releasesOfEarlierPresses[j];
+			std::map<std::pair<DWORD, int>, unsigned long long int>::iterator itr = pressTimestamps.find( std::make_pair(edge.controllerIndex, edge.buttonID) );
+			if ( itr==pressTimestamps.end() )
+				continue;		// Pressed since the start of the session
+			statistics.addHold( edge.buttonID, edge.timestampInNs - itr->second );
+			pressTimestamps.erase( itr );
+		}
+		for ( std::size_t j=0; j<chunk.unreleasedPresses.size(); ++j )
+		{
+			const ButtonEdge& edge = chunk.unreleasedPresses[j];
+			pressTimestamps[ std::make_pair(edge.controllerIndex, edge.buttonID) ] = edge.timestampInNs;
+		}
+
+		for ( std::size_t j=0; j<chunk.controllerEdges.size(); ++j )
+		{
+			const ControllerEdge& edge = chunk.controllerEdges[j];
+			std::map<DWORD, unsigned long long int>::iterator itr = lastStateTimestamps.find( edge.controllerIndex );
+			if ( edge.hasFirstState && itr!=lastStateTimestamps.end() )
+				statistics.addPacketInterval( edge.firstStateTimestampInNs - itr->second );
+			if ( edge.hasLastState )
+				lastStateTimestamps[edge.controllerIndex] = edge.lastStateTimestampInNs;
+			else if ( itr!=lastStateTimestamps.end() )
+				lastStateTimestamps.erase( itr );
+		}
+	}
+	return isMerged;
+}
+
+static double getPercentage( unsigned long long int count, unsigned long long int total )
+{
+	return total>0 ? 100.0 * count / total : 0.0;
+}
+
+static void printHistogram( const char* name, const unsigned long long int* histogram, unsigned int numBuckets, unsigned long long int total )
+{
+	printf( "%-22s", name );
+	for ( unsigned int i=0; i<numBuckets; ++i )
+		printf( " %5.1f", getPercentage( histogram[i], total ) );
+	printf( "\n" );
+}
+
+static void printBucketBounds( const unsigned long long int* upperBounds, unsigned int numBuckets, unsigned long long int divisor )
+{
+	char bound[32];
+	for ( unsigned int i=0; i+1<numBuckets; ++i )
+	{
+		snprintf( bound, sizeof(bound), "<%llu", upperBounds[i]/divisor );
+		printf( " %5s", bound );
+	}
+	printf( "  more\n" );
+}
+
+static void printReport( const Statistics& statistics )
+{
+	double recordedMinutes = statistics.recordedTimeInNs / 60e9;
+	printf( "Sessions: %llu, %.1f minutes recorded\n", statistics.numSessions, recordedMinutes );
+	printf( "Records: %llu (%llu state packets, %llu connections, %llu disconnections, %llu vibrations, %llu battery changes)\n\n", 
+		statistics.numRecords, statistics.numStates, statistics.numConnections, statistics.numDisconnections, statistics.numVibrations, statistics.numBatteryChanges );
+
+	printf( "%-22s %10s %12s %14s %14s\n", "Button", "presses", "presses/min", "mean hold (ms)", "max hold (ms)" );
+	for ( int i=0; i<Controller::Button_Count; ++i )
+	{
+		printf( "%-22s %10llu %12.1f %14.1f %14.1f\n", Controller::getButtonName( static_cast<Controller::ButtonID>(i) ), statistics.numPresses[i], 
+			recordedMinutes>0 ? statistics.numPresses[i] / recordedMinutes : 0.0, 
+			statistics.numHolds[i]>0 ? statistics.holdDurationInNs[i] / 1e6 / statistics.numHolds[i] : 0.0, statistics.maxHoldDurationInNs[i] / 1e6 );
+	}
+	unsigned long long int numHolds = 0;
+	for ( int i=0; i<Controller::Button_Count; ++i )
+		numHolds += statistics.numHolds[i];
+	printf( "\nHold durations (%% of the holds, ms):\n%-22s", "" );
+	printBucketBounds( holdDurationBucketsInMs, numHoldDurationBuckets, 1 );
+	printHistogram( "holds", statistics.holdDurationHistogram, numHoldDurationBuckets, numHolds );
+
+	printf( "\nPositions (%% of the state packets, by 1/%u of the range):\n", numHistogramBuckets );
+	for ( int i=0; i<Controller::Trigger_Count; ++i )
+		printHistogram( Controller::getTriggerName( static_cast<Controller::TriggerID>(i) ), statistics.triggerHistogram[i], numHistogramBuckets, statistics.numStates );
+	for ( int i=0; i<Controller::Thumbstick_Count; ++i )
+		printHistogram( Controller::getThumbstickName( static_cast<Controller::ThumbstickID>(i) ), statistics.thumbstickHistogram[i], numHistogramBuckets, statistics.numStates );
+
+	printf( "\nDead zone hits (%% of the state packets with a non-zero position in the default dead zone):\n" );
+	for ( int i=0; i<Controller::Trigger_Count; ++i )
+		printf( "%-22s %5.1f\n", Controller::getTriggerName( static_cast<Controller::TriggerID>(i) ), getPercentage( statistics.numTriggerDeadZoneHits[i], statistics.numStates ) );
+	for ( int i=0; i<Controller::Thumbstick_Count; ++i )
+		printf( "%-22s %5.1f\n", Controller::getThumbstickName( static_cast<Controller::ThumbstickID>(i) ), getPercentage( statistics.numThumbstickDeadZoneHits[i], statistics.numStates ) );
+
+	printf( "\nPacket intervals: %llu, mean %.3f ms (%.1f packets/s), min %.3f ms, max %.3f ms\n(%% of the intervals, ms):\n", statistics.numPacketIntervals, 
+		statistics.numPacketIntervals>0 ? statistics.packetIntervalSumInNs / 1e6 / statistics.numPacketIntervals : 0.0,
+		statistics.packetIntervalSumInNs>0 ? statistics.numPacketIntervals * 1e9 / statistics.packetIntervalSumInNs : 0.0,
+		statistics.numPacketIntervals>0 ? statistics.minPacketIntervalInNs / 1e6 : 0.0, statistics.maxPacketIntervalInNs / 1e6 );
+	printf( "%-22s", "" );
+	printBucketBounds( packetIntervalBucketsInUs, numPacketIntervalBuckets, 1000 );
+	printHistogram( "intervals", statistics.packetIntervalHistogram, numPacketIntervalBuckets, statistics.numPacketIntervals );
+}
+
+// Returns false if a session failed to open
+static bool analyzeSessions( const std::vector<std::string>& filenames, std::size_t chunkSizeInRecords, unsigned int numThreads, Statistics& statistics )
+{
+	std::vector<Chunk> chunks;
+	bool isOpened = makeChunks( filenames, chunkSizeInRecords, numThreads, chunks );
+	analyzeChunks( filenames, chunks, numThreads );
+	bool isMerged = mergeChunks( chunks, statistics );
+	return isOpened && isMerged;
+}
+
+int main( int argc, char* argv[] )
+{
+	unsigned int numThreads = std::max( 1u, std::thread::hardware_concurrency() );
+	std::size_t chunkSizeInRecords = 1<<18;
+	bool isCheckEnabled = false;
+	std::vector<std::string> filenames;
+	for ( int i=1; i<argc; ++i )
+	{
+		if ( strcmp( argv[i], "--threads" )==0 && i+1<argc )
+			numThreads = std::max( 1, atoi( argv[++i] ) );
+		else if ( strcmp( argv[i], "--chunk" )==0 && i+1<argc )
+			chunkSizeInRecords = std::max( 1, atoi( argv[++i] ) );
+		else if ( strcmp( argv[i], "--check" )==0 )
+			isCheckEnabled = true;
+		else
+			filenames.push_back( argv[i] );
+	}
+	if ( filenames.empty() )
+	{
+		printf( "Usage: RapaXInputAnalyzer [--threads n] [--chunk records] [--check] file...\n" );
+		return 1;
+	}
+
+	Statistics statistics;
+	bool isAnalyzed = analyzeSessions( filenames, chunkSizeInRecords, numThreads, statistics );
+	printReport( statistics );
+	if ( !isCheckEnabled )
+		return isAnalyzed ? 0 : 1;
+
+	// The statistics are sums, minimums and maximums of integers: they must be exactly the same
+	const std::size_t chunkSizesInRecords[4] = { 1000, 4096, 65536, static_cast<std::size_t>(-1) };
+	const unsigned int threadCounts[4] = { 1, 2, 3, numThreads };
+	unsigned int numDifferences = 0;
+	for ( int i=0; i<4; ++i )
+	{
+		for ( int j=0; j<4; ++j )
+		{
+			Statistics otherStatistics;
+			analyzeSessions( filenames, chunkSizesInRecords[i], threadCounts[j], otherStatistics );
+			if ( memcmp( &otherStatistics, &statistics, sizeof(Statistics) )==0 )
+				continue;
+			fprintf( stderr, "Different result with %u threads and chunks of %llu records\n", threadCounts[j], static_cast<unsigned long long int>(chunkSizesInRecords[i]) );
+			++numDifferences;
+		}
+	}
+	if ( numDifferences==0 )
+		printf( "\nCheck: the same results with 1 to %u threads and chunks of 1000 records to whole sessions\n", std::max( 3u, numThreads ) );
+	else
+		printf( "\nCheck: FAILED, %u different results\n", numDifferences );
+	return isAnalyzed && numDifferences==0 ? 0 : 1;
+}
@@ -22,8 +22,13 @@
    SOFTWARE.
 */
 #include "RXIControllerManager.h"
+#include "RXITimestamp.h"
+#ifndef _WIN32
+	#include "RXIEvdevBackend.h"
+#endif
 
 #include <assert.h> 
+#include <stdio.h> 
 #include <sstream> 
 #include <iostream> 
 #include <map> 
@@ -58,8 +63,13 @@ public:
 				break;
 			case RXI::Controller::ComponentType_VibrationMotor : 
 				componentName = RXI::Controller::getVibrationMotorName( static_cast<RXI::Controller::VibrationMotorID>(componentID) );
-				WORD speed = controller->getVibrationMotorSpeed( static_cast<RXI::Controller::VibrationMotorID>(componentID) );
-				stream << speed;
+				stream << controller->getVibrationMotorSpeed( static_cast<RXI::Controller::VibrationMotorID>(componentID) );
+				break;
+			case RXI::Controller::ComponentType_Battery : 
+				componentName = RXI::Controller::getBatteryName( static_cast<RXI::Controller::BatteryID>(componentID) );
+				stream << (int)controller->getBatteryLevel( static_cast<RXI::Controller::BatteryID>(componentID) );
+				break;
+			default:
 				break;
 		}
 
@@ -131,6 +141,7 @@ private:
 
 int main()
 {
+#ifdef _WIN32
  	RXI::ControllerManager manager;
 
 	DebugControllerManagerListener listener;
@@ -143,6 +154,29 @@ int main()
 		Sleep(10);
 		i++;
 	}
+#else
+	// On Linux, the controllers are read from evdev. Rather than polling them
+	// at a fixed interval, we sleep until one of them reports something
+	RXI::EvdevBackend backend;
+	backend.openDevices();
+ 	RXI::ControllerManager manager( &backend );
+
+	DebugControllerManagerListener listener;
+	manager.addListener( &listener );
+
+	unsigned long long int endTime = RXI::Timestamp::getTimestampInMs() + 20*1000;
+	std::vector<DWORD> changedControllers;
+	for ( ;; )
+	{
+		unsigned long long int time = RXI::Timestamp::getTimestampInMs();
+		if ( time>=endTime )
+			break;
+		if ( backend.waitForEvents( static_cast<int>(endTime-time), &changedControllers )<0 )
+			break;
+		for ( std::size_t i=0; i<changedControllers.size(); ++i )
+			manager.updateController( changedControllers[i] );
+	}
+#endif
 	
 	manager.removeListener( &listener );
 	return 0;
@@ -0,0 +1,142 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXIBatteryPoller.h"
+
+#include "RXIBackend.h"
+#include "RXITimestamp.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace RXI
+{
+
+// Bound to a reference by std::chrono::milliseconds: it needs a definition without optimizations
+const unsigned int BatteryPoller::mWakeUpIntervalInMs;
+
+BatteryPoller::BatteryPoller( Backend* backend, DWORD numMaxControllers )
+	:	mBackend(backend),
+		mNumMaxControllers(numMaxControllers),
+		mIntervalInMs(10000),
+		mLowLevelIntervalInMs(2000),
+		mThread(),
+		mStopRequested(false),
+		mNumQueries(0),
+		mIsConnected(numMaxControllers),
+		mIsQueryRequested(numMaxControllers),
+		mReports(numMaxControllers),
+		mNextQueryTimesInNs()
+{
+	for ( DWORD i=0; i<mNumMaxControllers; ++i )
+	{
+		mIsConnected[i] = false;
+		mIsQueryRequested[i] = false;
+	}
+	mNextQueryTimesInNs.resize( mNumMaxControllers, 0 );
+}
+
+BatteryPoller::~BatteryPoller()
+{
+	stop();
+}
+
+bool BatteryPoller::start()
+{
+	if ( !mBackend )
+		return false;		// Error: no backend to query
+	if ( !mBackend->isThreadSafe() )
+		return false;		// Error: the backend can't be queried from the poller thread
+	if ( isRunning() )
+		return false;		// Error: already started
+	mStopRequested = false;
+	mThread = std::thread( &BatteryPoller::run, this );
+	return true;
+}
+
+void BatteryPoller::stop()
+{
+	if ( !isRunning() )
+		return;
+	mStopRequested = true;
+	mThread.join();
+}
+
+void BatteryPoller::setControllerConnected( DWORD controllerIndex, bool connected )
+{
+	if ( controllerIndex>=mNumMaxControllers )
+		return;		// Error: wrong controller index
+	if ( connected )
+		mIsQueryRequested[controllerIndex] = true;
+	mIsConnected[controllerIndex] = connected;
+}
+
+void BatteryPoller::run()
+{
+	while ( !mStopRequested )
+	{
+		unsigned long long int time = Timestamp::getTimestampInNs();
+		for ( DWORD i=0; i<mNumMaxControllers && !mStopRequested; ++i )
+		{
+			if ( !mIsConnected[i] )
+				continue;
+			if ( mIsQueryRequested[i].exchange(false) || time>=mNextQueryTimesInNs[i] )
+				poll( i, time );
+		}
+
+		// The queries are not time-critical: a coarse sleep is enough
+		std::this_thread::sleep_for( std::chrono::milliseconds(mWakeUpIntervalInMs) );
+	}
+}
+
+void BatteryPoller::poll( DWORD controllerIndex, unsigned long long int timeInNs )
+{
+	Report report;
+	ZeroMemory( &report, sizeof(Report) );
+	unsigned long long int intervalInNs = mIntervalInMs * 1000000ULL;
+
+#ifndef _XINPUT_9_1_0
+	for ( BYTE devType=BATTERY_DEVTYPE_GAMEPAD; devType<=BATTERY_DEVTYPE_HEADSET; ++devType )
+	{
+		XINPUT_BATTERY_INFORMATION& batteryInformation = report.batteryInformation[devType];
+		if ( mBackend->getBatteryInformation( controllerIndex, devType, &batteryInformation )!=ERROR_SUCCESS )
+		{
+			// Error: same as no battery
+			batteryInformation.BatteryType = BATTERY_TYPE_DISCONNECTED;
+			batteryInformation.BatteryLevel = BATTERY_LEVEL_EMPTY;
+		}
+		mNumQueries++;
+	}
+
+	// Keep a closer eye on a battery that is running out
+	const XINPUT_BATTERY_INFORMATION& gamepadBattery = report.batteryInformation[BATTERY_DEVTYPE_GAMEPAD];
+	bool hasBattery = gamepadBattery.BatteryType!=BATTERY_TYPE_DISCONNECTED && gamepadBattery.BatteryType!=BATTERY_TYPE_WIRED;
+	if ( hasBattery && gamepadBattery.BatteryLevel<=BATTERY_LEVEL_LOW )
+		intervalInNs = std::min( intervalInNs, mLowLevelIntervalInMs * 1000000ULL );
+#endif
+
+	mReports[controllerIndex].store( report );
+	mNextQueryTimesInNs[controllerIndex] = timeInNs + intervalInNs;
+}
+
+}
@@ -23,23 +23,14 @@
 */
 #include "RXIController.h"
 
-// XInput must be included after windows.h
-#include <XInput.h>
-
-// Create a define corresponding to the version of XInput (none is officially provided!)
-// Here is some information about XInput versions:
-// http://msdn.microsoft.com/en-us/library/windows/desktop/hh405051(v=vs.85).aspx
-#ifdef XINPUT_DEVSUBTYPE_WHEEL					// Exists only since XInput 1.3 
-	#ifdef XINPUT_DEVSUBTYPE_GUITAR_ALTERNATE	// Exists only since XInput 1.4
-		#define _XINPUT_1_4
-	#else
-		#define _XINPUT_1_3
-	#endif
-#else
-	#define _XINPUT_9_1_0
-#endif
+#include "RXIXInput.h"
+#include "RXIBackend.h"
+#include "RXIBatteryPoller.h"
+#include "RXIInputRecorder.h"
 
 #include <algorithm>
+#include <limits>
+#include <math.h>
 #include "RXITimestamp.h"
 
 namespace RXI
@@ -106,6 +97,28 @@ const WORD	Controller::mButtonXInputID[Button_Count] =
 			XINPUT_GAMEPAD_Y
 		};
 
+// The reverse of the array above: for each bit of the XInput buttons bit-mask, 
+// the corresponding ButtonID (or Button_Count for the unused bits)
+const int	Controller::mXInputBitButtonID[16] = 
+		{
+			Button_DPadUp,
+			Button_DPadDown,
+			Button_DPadLeft,
+			Button_DPadRight,
+			Button_Start,
+			Button_Back,
+			Button_LeftThumbstick,
+			Button_RightThumbstick,
+			Button_LeftShoulder,
+			Button_RightShoulder,
+			Button_Count,
+			Button_Count,
+			Button_A,
+			Button_B,
+			Button_X,
+			Button_Y
+		};
+
 const char*	Controller::mTriggerName[Trigger_Count] = 
 		{
 			"Left Trigger",
@@ -137,8 +150,13 @@ const char*	Controller::mBatteryName[Battery_Count]  =
 			"Headset"
 		};
 
-Controller::Controller( DWORD controllerIndex, const void* xinputState )
-	:	mControllerIndex(controllerIndex),
+Controller::Controller( Backend* backend, DWORD controllerIndex, LatencyProfile* latencyProfile )
+	:	mBackend(backend),
+		mRecorder(NULL),
+		mLatencyProfile(latencyProfile),
+		mExcludedTimeInNs(0),
+		mIsUpdating(false),
+		mControllerIndex(controllerIndex),
 		mSubType(SubType_Gamepad),
 		mHasVoiceSupport(false),
 		//mHasButton(),		
@@ -146,7 +164,13 @@ Controller::Controller( DWORD controllerIndex, const void* xinputState )
 		//mHasThumbstick(),
 		//mHasVibrationMotor(),
 		//mHasBattery(),
-		mNextBatteryUpdateTime(0),
+		mUpdateTimestampInNs(0),
+		mBatteryUpdateIntervalInNs(10000000000ULL),
+		mNextBatteryUpdateTimeInNs(0),
+		mIsBatteryUpdateScheduled(false),
+		mNextUpdatedBattery(0),
+		mBatteryPoller(NULL),
+		mBatteryReportVersion(0),
 		mLastPacketNumber(0),
 		//mIsButtonPressed(),
 		//mTriggerPosition(),
@@ -154,41 +178,150 @@ Controller::Controller( DWORD controllerIndex, const void* xinputState )
 		//mThumbstickXPosition(),
 		//mThumbstickYPosition(),
 		//mThumbstickDeadZoneRadius(),
+		mThumbstickDeadZoneMethod(DeadZoneMethod_FloatingPoint),
 		//mVibrationMotorSpeed(),
+		//mRequestedVibrationMotorSpeed(),
+		mIsVibrationCoalescingEnabled(false),
+		mIsVibrationPending(false),
+		mNumVibrationWritesRequested(0),
+		mNumVibrationWritesIssued(0),
 		//mBatteryType(),
 		//mBatteryLevel(),
-		mListeners()
+		mIsStateDirty(true),
+		mPublishedState(),
+		mListeners(),
+		mBatchListeners(),
+		mChangesDepth(0),
+		mChangesTimestampInNs(0),
+		mPendingChanges(),
+		mDispatchedChanges()
+{
+	// Make room for a few listeners and the changes of a typical update up front, 
+	// so that connecting a preallocated Controller doesn't allocate memory
+	mListeners.reserve( mNumReservedListeners );
+	mBatchListeners.reserve( mNumReservedListeners );
+	mPendingChanges.reserve( mNumReservedChanges );
+	mDispatchedChanges.reserve( mNumReservedChanges );
+
+	clearCapabilities();
+	clearState();
+}
+
+Controller::~Controller()
+{
+}
+
+// Brings the Controller to the state of a freshly connected one. The ControllerManager 
+// reuses the same Controller object each time a controller gets connected to its slot. 
+// The capabilities and the battery information (of both the controller and the headset)
+// are queried unless they're given, in which case the motors are expected to be stopped 
+// already (see ControllerDiscovery)
+void Controller::connect( const void* xinputState, unsigned long long int timestampInNs, const void* xinputCapabilities, const void* xinputBatteryInformation )
 {
-	// Clear members
+	// Reset members
+	mSubType = SubType_Gamepad;
+	mHasVoiceSupport = false;
+	mLastPacketNumber = 0;
+	mThumbstickDeadZoneMethod = DeadZoneMethod_FloatingPoint;
+	mIsStateDirty = true;
+	mListeners.clear();
+	mBatchListeners.clear();
+	mChangesDepth = 0;
+	mPendingChanges.clear();
+	mDispatchedChanges.clear();
 	clearCapabilities();
 	clearState();
 
 	// Initialize capabilities (buttons, thumbsticks, etc...)
-	updateCapabilities();
+	XINPUT_CAPABILITIES capabilities;
+	ZeroMemory( &capabilities, sizeof(XINPUT_CAPABILITIES) );
+	if ( xinputCapabilities )
+	{
+		capabilities = *static_cast<const XINPUT_CAPABILITIES*>( xinputCapabilities );
+		applyCapabilities( &capabilities );
+	}
+	else
+	{
+		updateCapabilities( &capabilities );
+	}
+
+	if ( mRecorder )
+		mRecorder->recordConnection( getControllerIndex(), timestampInNs, capabilities );
 
 	// Initialize dead zones
 	mThumbstickDeadZoneRadius[Thumbstick_Left] = XINPUT_GAMEPAD_LEFT_THUMB_DEADZONE;
 	mThumbstickDeadZoneRadius[Thumbstick_Right] = XINPUT_GAMEPAD_RIGHT_THUMB_DEADZONE;
 	mTriggerDeadZone[Trigger_Left] = XINPUT_GAMEPAD_TRIGGER_THRESHOLD;
 	mTriggerDeadZone[Trigger_Right] = XINPUT_GAMEPAD_TRIGGER_THRESHOLD;
+	for ( int i=0; i<Trigger_Count; ++i )
+		updateTriggerTable( static_cast<TriggerID>(i) );
 
-	// Update from initial state (ensuring batter information is also updated)
-	mNextBatteryUpdateTime = Timestamp::getTimestampInMs();
-	update(xinputState);
-
-	// Ensure the motors are stopped
-	for ( int i=0; i<VibrationMotor_Count; ++i )
+	// Update from initial state (ensuring batter information is also updated, 
+	// unless it comes from the BatteryPoller which only queries it from now on)
+	mNextBatteryUpdateTimeInNs = timestampInNs;
+	mNextUpdatedBattery = 0;
+	if ( xinputBatteryInformation )
 	{
-		mVibrationMotorSpeed[static_cast<VibrationMotorID>(i)] = 1;		// Make sure setter call below will effectively affect device/hardware 
-		setVibrationMotorSpeed( static_cast<VibrationMotorID>(i), 0 );
+		const XINPUT_BATTERY_INFORMATION* batteryInformation = static_cast<const XINPUT_BATTERY_INFORMATION*>( xinputBatteryInformation );
+		bool changed = false;
+		for ( unsigned int i=0; i<Battery_Count; ++i )
+		{
+			bool hasBattery = false;
+			BatteryType batteryType = BatteryType_Unknown;
+			BYTE batteryLevel = 0;
+			xinputBatteryInformationToBatteryInformation( &batteryInformation[i], hasBattery, batteryType, batteryLevel );
+			changed |= setBatteryInformation( static_cast<BatteryID>(i), hasBattery, batteryType, batteryLevel );
+		}
+		if ( changed )
+			recordBattery( timestampInNs );
+		mNextBatteryUpdateTimeInNs = timestampInNs + mBatteryUpdateIntervalInNs;
 	}
+	if ( mBatteryPoller )
+		mBatteryReportVersion = mBatteryPoller->getReportVersion( getControllerIndex() );
+	update( xinputState, timestampInNs );
+
+	// Ensure the motors are stopped
+	if ( !xinputCapabilities && ( hasVibrationMotor(VibrationMotor_Left) || hasVibrationMotor(VibrationMotor_Right) ) )
+		writeVibrationMotorSpeeds( 0, 0, true );
+
+	// Make the initial state available to the other threads
+	publishState();
 }
 
-Controller::~Controller()
+void Controller::disconnect()
 {
-	// Ensure the motors are stopped
-	for ( int i=0; i<VibrationMotor_Count; ++i )
-		setVibrationMotorSpeed( static_cast<VibrationMotorID>(i), 0 );
+	if ( mRecorder )
+		mRecorder->recordDisconnection( getControllerIndex(), getRecordTimestampInNs() );
+
+	// Ensure the motors are stopped, without waiting for a flush
+	mIsVibrationPending = false;
+	writeVibrationMotorSpeeds( 0, 0, false );
+}
+
+// Records the connection, the current state and the battery information of the controller, 
+// as if it had just been connected. For the recordings started while the controller is connected
+void Controller::recordConnection()
+{
+	if ( !mRecorder )
+		return;
+
+	XINPUT_CAPABILITIES capabilities;
+	ZeroMemory( &capabilities, sizeof(XINPUT_CAPABILITIES) );
+	mBackend->getCapabilities( getControllerIndex(), XINPUT_FLAG_GAMEPAD, &capabilities );
+
+	XINPUT_STATE state;
+	ZeroMemory( &state, sizeof(XINPUT_STATE) );
+	state.dwPacketNumber = mLastPacketNumber;
+	state.Gamepad.wButtons = mRawButtons;
+	state.Gamepad.bLeftTrigger = mRawTriggerPosition[Trigger_Left];
+	state.Gamepad.bRightTrigger = mRawTriggerPosition[Trigger_Right];
+	state.Gamepad.sThumbLX = mRawThumbstickXPosition[Thumbstick_Left];
+	state.Gamepad.sThumbLY = mRawThumbstickYPosition[Thumbstick_Left];
+	state.Gamepad.sThumbRX = mRawThumbstickXPosition[Thumbstick_Right];
+	state.Gamepad.sThumbRY = mRawThumbstickYPosition[Thumbstick_Right];
+	mRecorder->recordConnection( getControllerIndex(), mUpdateTimestampInNs, capabilities );
+	mRecorder->recordState( getControllerIndex(), mUpdateTimestampInNs, state );
+	recordBattery( mUpdateTimestampInNs );
 }
 
 void Controller::clearCapabilities()
@@ -218,6 +351,7 @@ void Controller::clearState()
 	{
 		mTriggerPosition[i] = 0;
 		mTriggerDeadZone[i] = 0;
+		mTriggerResponseCurve[i] = ResponseCurve_Linear;
 	}
 
 	for ( int i=0; i<Thumbstick_Count; ++i )
@@ -227,8 +361,21 @@ void Controller::clearState()
 		mThumbstickDeadZoneRadius[i] = 0;
 	}
 
+	mRawButtons = 0;
+	for ( int i=0; i<Trigger_Count; ++i )
+		mRawTriggerPosition[i] = 0;
+	for ( int i=0; i<Thumbstick_Count; ++i )
+	{
+		mRawThumbstickXPosition[i] = 0;
+		mRawThumbstickYPosition[i] = 0;
+	}
+
 	for ( int i=0; i<VibrationMotor_Count; ++i )
+	{
 		mVibrationMotorSpeed[i] = 0;
+		mRequestedVibrationMotorSpeed[i] = 0;
+	}
+	mIsVibrationPending = false;
 
 	for ( int i=0; i<Battery_Count; ++i )
 	{
@@ -239,15 +386,25 @@ void Controller::clearState()
 
 // Update the capabilities of the controller in terms of components
 // The batteries capabilities are left aside as they can change dynamically.
-void Controller::updateCapabilities()
+// Queries the capabilities and applies them. They're also copied to xinputCapabilities, 
+// which is left untouched if the query fails
+void Controller::updateCapabilities( void* xinputCapabilities )
 {
 	XINPUT_CAPABILITIES capabilities;
 	DWORD dwResult;
 	ZeroMemory( &capabilities, sizeof(XINPUT_CAPABILITIES) );
-	dwResult = XInputGetCapabilities( getControllerIndex(), XINPUT_FLAG_GAMEPAD, &capabilities );
+	dwResult = mBackend->getCapabilities( getControllerIndex(), XINPUT_FLAG_GAMEPAD, &capabilities );
 	if ( dwResult!=ERROR_SUCCESS )
 		return;			// Error: failed to read capabilities
 	
+	applyCapabilities( &capabilities );
+	*static_cast<XINPUT_CAPABILITIES*>( xinputCapabilities ) = capabilities;
+}
+
+void Controller::applyCapabilities( const void* xinputCapabilities )
+{
+	const XINPUT_CAPABILITIES& capabilities = *static_cast<const XINPUT_CAPABILITIES*>( xinputCapabilities );
+
 	// Sub-type
 	mSubType = xinputSubTypeToSubType( capabilities.SubType );
 
@@ -286,37 +443,102 @@ void Controller::updateCapabilities()
 
 void Controller::setVibrationMotorSpeed( VibrationMotorID motorID, WORD speed )
 {
+	if ( motorID>=VibrationMotor_Count )
+		return;
 	if ( !hasVibrationMotor(motorID) )
 		return;
+	++mNumVibrationWritesRequested;
 
-	if ( mVibrationMotorSpeed[motorID]==speed )
+	if ( mIsVibrationCoalescingEnabled )
+	{
+		// Only the last speed of each motor before the flush matters
+		mRequestedVibrationMotorSpeed[motorID] = speed;
+		mIsVibrationPending = true;
 		return;
-	
-	XINPUT_VIBRATION vibrationStruct;
-	ZeroMemory( &vibrationStruct, sizeof(XINPUT_VIBRATION) );
-	if ( motorID==VibrationMotor_Left )
+	}
+
+	WORD speeds[VibrationMotor_Count] = { mVibrationMotorSpeed[VibrationMotor_Left], mVibrationMotorSpeed[VibrationMotor_Right] };
+	speeds[motorID] = speed;
+	writeVibrationMotorSpeeds( speeds[VibrationMotor_Left], speeds[VibrationMotor_Right], false );
+}
+
+void Controller::setVibration( WORD leftSpeed, WORD rightSpeed )
+{
+	if ( !hasVibrationMotor(VibrationMotor_Left) && !hasVibrationMotor(VibrationMotor_Right) )
+		return;
+	++mNumVibrationWritesRequested;
+
+	WORD speeds[VibrationMotor_Count] = { leftSpeed, rightSpeed };
+	const WORD* currentSpeeds = mIsVibrationCoalescingEnabled ? mRequestedVibrationMotorSpeed : mVibrationMotorSpeed;
+	for ( int i=0; i<VibrationMotor_Count; ++i )
 	{
-		vibrationStruct.wLeftMotorSpeed = speed;
-		vibrationStruct.wRightMotorSpeed = mVibrationMotorSpeed[VibrationMotor_Right];
+		if ( !hasVibrationMotor( static_cast<VibrationMotorID>(i) ) )
+			speeds[i] = currentSpeeds[i];
 	}
-	else if ( motorID==VibrationMotor_Right )
+
+	if ( mIsVibrationCoalescingEnabled )
 	{
-		vibrationStruct.wLeftMotorSpeed = mVibrationMotorSpeed[VibrationMotor_Left];
-		vibrationStruct.wRightMotorSpeed = speed;
+		mRequestedVibrationMotorSpeed[VibrationMotor_Left] = speeds[VibrationMotor_Left];
+		mRequestedVibrationMotorSpeed[VibrationMotor_Right] = speeds[VibrationMotor_Right];
+		mIsVibrationPending = true;
+		return;
 	}
+	writeVibrationMotorSpeeds( speeds[VibrationMotor_Left], speeds[VibrationMotor_Right], false );
+}
 
-	DWORD dwResult = XInputSetState( getControllerIndex(), &vibrationStruct );
-	if ( dwResult!=ERROR_SUCCESS )
-		return;			// Failed to change the value of the motors
+// Sends the speeds staged by setVibrationMotorSpeed() to the device. 
+// A failed write is retried on the next flush
+void Controller::flushVibration()
+{
+	if ( !mIsVibrationPending )
+		return;
+	
+	// Cleared first as the listeners notified by the write can stage new speeds
+	mIsVibrationPending = false;
+	if ( !writeVibrationMotorSpeeds( mRequestedVibrationMotorSpeed[VibrationMotor_Left], mRequestedVibrationMotorSpeed[VibrationMotor_Right], false ) )
+		mIsVibrationPending = true;
+}
+
+// Sets both motors in a single write to the device. Nothing is written when the 
+// speeds are already the current ones, unless forced. Returns false on failure
+bool Controller::writeVibrationMotorSpeeds( WORD leftSpeed, WORD rightSpeed, bool force )
+{
+	if ( !force && leftSpeed==mVibrationMotorSpeed[VibrationMotor_Left] && rightSpeed==mVibrationMotorSpeed[VibrationMotor_Right] )
+		return true;
 
-	if ( motorID==VibrationMotor_Left )
-		mVibrationMotorSpeed[VibrationMotor_Left] = speed;
-	else if ( motorID==VibrationMotor_Right )
-		mVibrationMotorSpeed[VibrationMotor_Right] = speed;
+	XINPUT_VIBRATION vibrationStruct;
+	ZeroMemory( &vibrationStruct, sizeof(XINPUT_VIBRATION) );
+	vibrationStruct.wLeftMotorSpeed = leftSpeed;
+	vibrationStruct.wRightMotorSpeed = rightSpeed;
+	++mNumVibrationWritesIssued;
+	DWORD dwResult = mBackend->setState( getControllerIndex(), &vibrationStruct );
+	if ( dwResult!=ERROR_SUCCESS )
+		return false;			// Failed to change the value of the motors
+	if ( mRecorder )
+		mRecorder->recordVibration( getControllerIndex(), getRecordTimestampInNs(), vibrationStruct );
+
+	WORD oldSpeeds[VibrationMotor_Count] = { mVibrationMotorSpeed[VibrationMotor_Left], mVibrationMotorSpeed[VibrationMotor_Right] };
+	mVibrationMotorSpeed[VibrationMotor_Left] = leftSpeed;
+	mVibrationMotorSpeed[VibrationMotor_Right] = rightSpeed;
+	if ( !mIsVibrationPending )
+	{
+		mRequestedVibrationMotorSpeed[VibrationMotor_Left] = leftSpeed;
+		mRequestedVibrationMotorSpeed[VibrationMotor_Right] = rightSpeed;
+	}
+	if ( oldSpeeds[VibrationMotor_Left]==leftSpeed && oldSpeeds[VibrationMotor_Right]==rightSpeed )
+		return true;
+	mIsStateDirty = true;
+	publishState();
 
 	// Notify
-	for ( Listeners::iterator itr=mListeners.begin(); itr!=mListeners.end(); ++itr )
-		(*itr)->onComponentChanged( this, ComponentType_VibrationMotor, motorID );
+	beginChanges( mBatchListeners.empty() ? 0 : Timestamp::getTimestampInNs() );
+	for ( int i=0; i<VibrationMotor_Count; ++i )
+	{
+		if ( mVibrationMotorSpeed[i]!=oldSpeeds[i] )
+			notifyComponentChanged( ComponentType_VibrationMotor, i, oldSpeeds[i], mVibrationMotorSpeed[i] );
+	}
+	endChanges();
+	return true;
 }
 
 void Controller::setButtonPressed( ButtonID buttonID, bool pressed )
@@ -329,10 +551,10 @@ void Controller::setButtonPressed( ButtonID buttonID, bool pressed )
 		return;
 
 	mIsButtonPressed[buttonID] = pressed;
+	mIsStateDirty = true;
 
 	// Notify
-	for ( Listeners::iterator itr=mListeners.begin(); itr!=mListeners.end(); ++itr )
-		(*itr)->onComponentChanged( this, ComponentType_Button, buttonID );
+	notifyComponentChanged( ComponentType_Button, buttonID, !pressed, pressed );
 }
 
 BYTE Controller::applyTriggerDeadZone( BYTE position, BYTE deadZoneRadius )
@@ -353,6 +575,50 @@ BYTE Controller::applyTriggerDeadZone( BYTE position, BYTE deadZoneRadius )
 	return outPosition;
 }
 
+void Controller::setTriggerDeadZone( TriggerID triggerID, BYTE deadZone )
+{
+	if ( triggerID>=Trigger_Count )
+		return;
+	if ( mTriggerDeadZone[triggerID]==deadZone )
+		return;
+	mTriggerDeadZone[triggerID] = deadZone;
+	updateTriggerTable( triggerID );
+}
+
+void Controller::setTriggerResponseCurve( TriggerID triggerID, ResponseCurve curve )
+{
+	if ( triggerID>=Trigger_Count || curve>=ResponseCurve_Count )
+		return;
+	if ( mTriggerResponseCurve[triggerID]==curve )
+		return;
+	mTriggerResponseCurve[triggerID] = curve;
+	updateTriggerTable( triggerID );
+}
+
+// A trigger position only has 256 possible values. The dead zone and response curve 
+// are precomputed for all of them whenever the settings change, and the trigger 
+// position is re-evaluated from its last raw value
+void Controller::updateTriggerTable( TriggerID triggerID )
+{
+	BYTE* table = mTriggerTable[triggerID];
+	for ( int i=0; i<256; ++i )
+	{
+		unsigned int position = applyTriggerDeadZone( static_cast<BYTE>(i), mTriggerDeadZone[triggerID] );
+		switch ( mTriggerResponseCurve[triggerID] )
+		{
+			case ResponseCurve_Quadratic :	position = (position*position) / 255; break;
+			case ResponseCurve_Cubic :		position = (position*position*position) / (255*255); break;
+			default :						break;
+		}
+		table[i] = static_cast<BYTE>( position );
+	}
+
+	beginChanges( mBatchListeners.empty() ? 0 : Timestamp::getTimestampInNs() );
+	setTriggerPosition( triggerID, mRawTriggerPosition[triggerID] );
+	publishState();
+	endChanges();
+}
+
 void Controller::setTriggerPosition( TriggerID triggerID, BYTE position )
 {
 	if ( triggerID>=Trigger_Count )
@@ -360,15 +626,16 @@ void Controller::setTriggerPosition( TriggerID triggerID, BYTE position )
 	if ( !hasTrigger(triggerID) )
 		return;
 	
-	BYTE pos = applyTriggerDeadZone( position, mTriggerDeadZone[triggerID] );
+	BYTE pos = mTriggerTable[triggerID][position];
 	if ( mTriggerPosition[triggerID]==pos)
 		return;
 	
+	BYTE oldPos = mTriggerPosition[triggerID];
 	mTriggerPosition[triggerID] = pos;
+	mIsStateDirty = true;
 		
 	// Notify
-	for ( Listeners::iterator itr=mListeners.begin(); itr!=mListeners.end(); ++itr )
-		(*itr)->onComponentChanged( this, ComponentType_Trigger, triggerID );
+	notifyComponentChanged( ComponentType_Trigger, triggerID, oldPos, pos );
 }
 
 void Controller::applyThumbstickDeadZone( SHORT inX, SHORT inY, SHORT& outX, SHORT& outY, SHORT deadZoneRadius )
@@ -382,16 +649,16 @@ void Controller::applyThumbstickDeadZone( SHORT inX, SHORT inY, SHORT& outX, SHO
 	float x = static_cast<float>(inX);
 	float y = static_cast<float>(inY);
 	float magnitude = sqrt(x*x + y*y);
-	float dirX = x / magnitude;
-	float dirY = y / magnitude;
 		
 	float radius = static_cast<float>( deadZoneRadius );
-	if ( magnitude>radius)
+	float maxMagnitude = static_cast<float>( std::numeric_limits<SHORT>::max() );
+	if ( magnitude>radius && radius<maxMagnitude )
 	{
-		// The thumbstick is outside the dead zone
+		// The thumbstick is outside the dead zone (so the magnitude can't be null)
+		float dirX = x / magnitude;
+		float dirY = y / magnitude;
 		
 		// Clip the magnitude at its expected maximum value
-		float maxMagnitude = static_cast<float>( std::numeric_limits<SHORT>::max() );
 		if (magnitude>maxMagnitude) 
 			magnitude=maxMagnitude;
   
@@ -404,12 +671,129 @@ void Controller::applyThumbstickDeadZone( SHORT inX, SHORT inY, SHORT& outX, SHO
 	}
 	else 
 	{
-		// The thumbstick is inside the dead zone
+		// The thumbstick is inside the dead zone, which covers the whole range 
+		// (corners included) when the radius is the maximum magnitude
 		outX = 0;
 		outY = 0;
 	}
 }
 
+namespace
+{
+
+// Index of the highest bit set in a non-null value
+inline int getHighestBitIndex( unsigned int value )
+{
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanReverse( &index, value );
+	return static_cast<int>( index );
+#else
+	return 31 - __builtin_clz( value );
+#endif
+}
+
+// Table of 1/sqrt(M) for M in [1,4) in steps of 1/256, with 30 fractional bits.
+// Entry i corresponds to M=i/256, so only the entries 256 to 1024 are used
+struct ReciprocalSquareRootTable
+{
+	ReciprocalSquareRootTable()
+	{
+		for ( int i=0; i<=1024; ++i )
+			mValues[i] = ( i==0 ) ? 0 : static_cast<int>( (1<<30) / sqrt( static_cast<double>(i)/256.0 ) + 0.5 );
+	}
+	int mValues[1025];
+};
+const ReciprocalSquareRootTable reciprocalSquareRootTable;
+
+}
+
+// Same as applyThumbstickDeadZone() with integer arithmetic only. 
+// The formula is rewritten in terms of g=1/magnitude:
+//		out = in * (min(magnitude,max) - radius) / magnitude * max/(max-radius)
+//			= in * (min(1,max*g) - radius*g) * max/(max-radius)
+// g is read from a table with linear interpolation, then refined with one 
+// Newton-Raphson iteration: the error on g is multiplied by max/(max-radius), 
+// which gets as large as 32767 for the largest radii
+void Controller::applyThumbstickDeadZoneFixedPoint( SHORT inX, SHORT inY, SHORT& outX, SHORT& outY, SHORT deadZoneRadius )
+{
+	outX = inX;
+	outY = inY;
+	if (deadZoneRadius<=0)		// Negative radius is considered same as null
+		return;
+
+	// Compare squared magnitudes first: nothing else to do when inside the dead zone 
+	int x = inX;
+	int y = inY;
+	unsigned int magnitudeSquared = static_cast<unsigned int>( x*x ) + static_cast<unsigned int>( y*y );
+	unsigned int radius = static_cast<unsigned int>( deadZoneRadius );
+	const long long int maxMagnitude = std::numeric_limits<SHORT>::max();
+	if ( magnitudeSquared<=radius*radius || radius>=maxMagnitude )
+	{
+		outX = 0;
+		outY = 0;
+		return;
+	}
+
+	// Write magnitudeSquared as M*2^30*2^-shift with M in [1,4) and an even shift, 
+	// so that g = 1/sqrt(M) * 2^(shift/2-15)
+	int shift = ( 31 - getHighestBitIndex(magnitudeSquared) ) & ~1;
+	unsigned int normalized = magnitudeSquared << shift;
+	unsigned int index = normalized >> 22;
+	long long int fraction = ( normalized >> 6 ) & 0xFFFF;
+	long long int value = reciprocalSquareRootTable.mValues[index];
+	long long int nextValue = reciprocalSquareRootTable.mValues[index+1];
+	long long int reciprocalSqrtM = value + ( ( (nextValue-value) * fraction ) >> 16 );	// 30 fractional bits
+	long long int squared = ( reciprocalSqrtM * reciprocalSqrtM ) >> 30;
+	long long int residual = ( 3LL << 30 ) - ( ( static_cast<long long int>(normalized) * squared ) >> 30 );
+	reciprocalSqrtM = ( reciprocalSqrtM * residual ) >> 31;
+	int exponentShift = 15 - shift/2;
+
+	// The terms of the formula, with 30 fractional bits. The scale is divided by 
+	// (max-radius) last so that no precision is lost on the large factors
+	const long long int one = 1LL << 30;
+	long long int clippedTerm = std::min( one, ( maxMagnitude * reciprocalSqrtM ) >> exponentShift );
+	long long int radiusTerm = ( static_cast<long long int>(radius) * reciprocalSqrtM ) >> exponentShift;
+	long long int scale = ( ( clippedTerm - radiusTerm ) * maxMagnitude ) / ( maxMagnitude - radius );
+
+	// Truncate toward zero like the floating-point version
+	long long int scaledX = ( (x<0 ? -x : x) * scale ) >> 30;
+	long long int scaledY = ( (y<0 ? -y : y) * scale ) >> 30;
+	outX = static_cast<SHORT>( x<0 ? -scaledX : scaledX );
+	outY = static_cast<SHORT>( y<0 ? -scaledY : scaledY );
+}
+
+void Controller::setThumbstickDeadZoneRadius( ThumbstickID thumbstickID, SHORT radius )
+{
+	if ( thumbstickID>=Thumbstick_Count )
+		return;	
+	if ( mThumbstickDeadZoneRadius[thumbstickID]==radius )
+		return;
+	mThumbstickDeadZoneRadius[thumbstickID] = radius;
+	reapplyThumbstickDeadZones();
+}
+
+void Controller::setThumbstickDeadZoneMethod( DeadZoneMethod method )
+{
+	if ( method>=DeadZoneMethod_Count )
+		return;
+	if ( mThumbstickDeadZoneMethod==method )
+		return;
+	mThumbstickDeadZoneMethod = method;
+	reapplyThumbstickDeadZones();
+}
+
+// Recomputes the thumbstick positions from the last raw values, so that a change 
+// of dead zone settings is taken into account immediately
+void Controller::reapplyThumbstickDeadZones()
+{
+	beginChanges( mBatchListeners.empty() ? 0 : Timestamp::getTimestampInNs() );
+	for ( int i=0; i<Thumbstick_Count; ++i )
+		setThumbstickPosition( static_cast<ThumbstickID>(i), mRawThumbstickXPosition[i], mRawThumbstickYPosition[i] );
+	publishState();
+	endChanges();
+}
+
 void Controller::setThumbstickPosition( ThumbstickID thumbstickID, SHORT positionX, SHORT positionY )
 {
 	if ( thumbstickID>=Thumbstick_Count )
@@ -419,64 +803,162 @@ void Controller::setThumbstickPosition( ThumbstickID thumbstickID, SHORT positio
 
 	SHORT posX = 0;
 	SHORT posY = 0;
-	applyThumbstickDeadZone( positionX, positionY, posX, posY, mThumbstickDeadZoneRadius[thumbstickID] );
-	
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+	unsigned long long int startTime = Timestamp::getTimestampInNs();
+#endif
+	if ( mThumbstickDeadZoneMethod==DeadZoneMethod_FixedPoint )
+		applyThumbstickDeadZoneFixedPoint( positionX, positionY, posX, posY, mThumbstickDeadZoneRadius[thumbstickID] );
+	else
+		applyThumbstickDeadZone( positionX, positionY, posX, posY, mThumbstickDeadZoneRadius[thumbstickID] );
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+	mExcludedTimeInNs += mLatencyProfile->record( LatencyProfile::Stage_DeadZone, startTime );
+#endif
+	setFilteredThumbstickPosition( thumbstickID, posX, posY );
+}
+
+// Same as setThumbstickPosition() with a position that already went through the dead zone
+void Controller::setFilteredThumbstickPosition( ThumbstickID thumbstickID, SHORT posX, SHORT posY )
+{
+	if ( thumbstickID>=Thumbstick_Count )
+		return;	
+	if ( !hasThumbstick(thumbstickID) )
+		return;
+
 	if ( posX==mThumbstickXPosition[thumbstickID] && posY==mThumbstickYPosition[thumbstickID] )
 		return;
 
+	SHORT oldPosX = mThumbstickXPosition[thumbstickID];
+	SHORT oldPosY = mThumbstickYPosition[thumbstickID];
 	mThumbstickXPosition[thumbstickID] = posX;
 	mThumbstickYPosition[thumbstickID] = posY;
+	mIsStateDirty = true;
 		
 	// Notify
-	for ( Listeners::iterator itr=mListeners.begin(); itr!=mListeners.end(); ++itr )
-		(*itr)->onComponentChanged( this, ComponentType_Thumbstick, thumbstickID );
+	notifyComponentChanged( ComponentType_Thumbstick, thumbstickID, oldPosX, posX, oldPosY, posY );
 }
 
-void Controller::update( const void* xinputState )
+// The timestamp tells when the state was read from the device. 
+// The filteredThumbstickPositions are the left X, left Y, right X and right Y positions 
+// with the dead zone already applied, when the ControllerManager processed all 
+// the controllers at once. When NULL, the dead zone is applied here
+void Controller::update( const void* xinputState, unsigned long long int timestampInNs, const SHORT* filteredThumbstickPositions )
 {
 	if ( !xinputState )
 		return;
 	const XINPUT_STATE& state = *( static_cast<const XINPUT_STATE*>(xinputState) );
 	
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+	unsigned long long int startTime = Timestamp::getTimestampInNs();
+	mExcludedTimeInNs = 0;
+#endif
+	mIsUpdating = true;
+
+	// The changes are accumulated and delivered to the batch listeners at the end
+	mUpdateTimestampInNs = timestampInNs;
+	beginChanges( timestampInNs );
+
 	// Update components state
 	DWORD currentPacketNumber = state.dwPacketNumber;
 	if ( currentPacketNumber!=mLastPacketNumber )
 	{
 		mLastPacketNumber = currentPacketNumber;
+		mIsStateDirty = true;
+		if ( mRecorder )
+			mRecorder->recordState( getControllerIndex(), timestampInNs, state );
 		const XINPUT_GAMEPAD& gamepad = state.Gamepad;
 		
-		// Buttons
-		WORD buttonStates = gamepad.wButtons;
-		for ( int i=0; i<Button_Count; ++i )
+		// Only the components whose raw value differs from the previous packet are 
+		// updated. This is cheap as a packet usually changes very few things
+		
+		// Buttons: only go through the bits that flipped. The bits are in the same 
+		// order as the ButtonIDs, so the notifications order is preserved
+		WORD changedButtons = static_cast<WORD>( gamepad.wButtons ^ mRawButtons );
+		mRawButtons = gamepad.wButtons;
+		for ( int bit=0; changedButtons!=0; ++bit, changedButtons>>=1 )
 		{
-			bool pressed = ( buttonStates & mButtonXInputID[i] )!=0;
-			setButtonPressed( static_cast<ButtonID>(i), pressed );
+			if ( (changedButtons & 1)==0 )
+				continue;
+			int buttonID = mXInputBitButtonID[bit];
+			if ( buttonID<Button_Count )
+				setButtonPressed( static_cast<ButtonID>(buttonID), ( gamepad.wButtons & (1<<bit) )!=0 );
 		}
 
 		// Triggers
-		setTriggerPosition( Trigger_Left, gamepad.bLeftTrigger );
-		setTriggerPosition( Trigger_Right, gamepad.bRightTrigger );
+		if ( gamepad.bLeftTrigger!=mRawTriggerPosition[Trigger_Left] )
+		{
+			mRawTriggerPosition[Trigger_Left] = gamepad.bLeftTrigger;
+			setTriggerPosition( Trigger_Left, gamepad.bLeftTrigger );
+		}
+		if ( gamepad.bRightTrigger!=mRawTriggerPosition[Trigger_Right] )
+		{
+			mRawTriggerPosition[Trigger_Right] = gamepad.bRightTrigger;
+			setTriggerPosition( Trigger_Right, gamepad.bRightTrigger );
+		}
 		
 		// Thumbsticks
-		setThumbstickPosition( Thumbstick_Left, gamepad.sThumbLX, gamepad.sThumbLY );
-		setThumbstickPosition( Thumbstick_Right, gamepad.sThumbRX, gamepad.sThumbRY );
+		if ( gamepad.sThumbLX!=mRawThumbstickXPosition[Thumbstick_Left] || gamepad.sThumbLY!=mRawThumbstickYPosition[Thumbstick_Left] )
+		{
+			mRawThumbstickXPosition[Thumbstick_Left] = gamepad.sThumbLX;
+			mRawThumbstickYPosition[Thumbstick_Left] = gamepad.sThumbLY;
+			if ( filteredThumbstickPositions )
+				setFilteredThumbstickPosition( Thumbstick_Left, filteredThumbstickPositions[0], filteredThumbstickPositions[1] );
+			else
+				setThumbstickPosition( Thumbstick_Left, gamepad.sThumbLX, gamepad.sThumbLY );
+		}
+		if ( gamepad.sThumbRX!=mRawThumbstickXPosition[Thumbstick_Right] || gamepad.sThumbRY!=mRawThumbstickYPosition[Thumbstick_Right] )
+		{
+			mRawThumbstickXPosition[Thumbstick_Right] = gamepad.sThumbRX;
+			mRawThumbstickYPosition[Thumbstick_Right] = gamepad.sThumbRY;
+			if ( filteredThumbstickPositions )
+				setFilteredThumbstickPosition( Thumbstick_Right, filteredThumbstickPositions[2], filteredThumbstickPositions[3] );
+			else
+				setThumbstickPosition( Thumbstick_Right, gamepad.sThumbRX, gamepad.sThumbRY );
+		}
 	}
 
 	// Update battery state
-	unsigned int time = Timestamp::getTimestampInMs();
-	if ( time>=mNextBatteryUpdateTime )
+	if ( mBatteryPoller )
 	{
-		mNextBatteryUpdateTime = time + mBatteryUpdateIntervalInMs;
-		
-		for ( unsigned int i=0; i<Battery_Count; ++i )
-		{
-			bool hasBattery = false;
-			BatteryType batteryType = BatteryType_Unknown;
-			BYTE batteryLevel = 0;
-			getBatteryInformation( static_cast<BatteryID>(i), hasBattery, batteryType, batteryLevel );
-			setBatteryInformation( static_cast<BatteryID>(i), hasBattery, batteryType, batteryLevel );
-		}
+		applyBatteryReport( timestampInNs );
 	}
+	else if ( !mIsBatteryUpdateScheduled && timestampInNs>=mNextBatteryUpdateTimeInNs )
+	{
+		updateBattery( timestampInNs );
+	}
+
+	publishState();
+	endChanges();
+	
+	mIsUpdating = false;
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+	mLatencyProfile->recordDuration( LatencyProfile::Stage_Diff, Timestamp::getTimestampInNs() - startTime - mExcludedTimeInNs );
+#endif
+}
+
+// Makes the current state available to the other threads if it changed since the last time
+void Controller::publishState()
+{
+	if ( !mIsStateDirty )
+		return;
+	mIsStateDirty = false;
+
+	State state;
+	state.packetNumber = mLastPacketNumber;
+	state.timestampInNs = mUpdateTimestampInNs;
+	for ( int i=0; i<Button_Count; ++i )
+		state.isButtonPressed[i] = mIsButtonPressed[i];
+	for ( int i=0; i<Trigger_Count; ++i )
+		state.triggerPosition[i] = mTriggerPosition[i];
+	for ( int i=0; i<Thumbstick_Count; ++i )
+	{
+		state.thumbstickXPosition[i] = mThumbstickXPosition[i];
+		state.thumbstickYPosition[i] = mThumbstickYPosition[i];
+	}
+	for ( int i=0; i<VibrationMotor_Count; ++i )
+		state.vibrationMotorSpeed[i] = mVibrationMotorSpeed[i];
+	for ( int i=0; i<Battery_Count; ++i )
+		state.batteryLevel[i] = mBatteryLevel[i];
+	mPublishedState.store( state );
 }
 
 void Controller::getBatteryInformation( BatteryID batteryID, bool& hasBattery, BatteryType& batteryType, BYTE& batteryLevel ) const
@@ -503,25 +985,103 @@ void Controller::getBatteryInformation( BatteryID batteryID, bool& hasBattery, B
 	DWORD dwResult;
 	XINPUT_BATTERY_INFORMATION batteryInformation;
 	ZeroMemory( &batteryInformation, sizeof(XINPUT_BATTERY_INFORMATION) );
-	dwResult = XInputGetBatteryInformation( getControllerIndex(), devType, &batteryInformation );
+	dwResult = mBackend->getBatteryInformation( getControllerIndex(), devType, &batteryInformation );
 	if ( dwResult!=ERROR_SUCCESS )
 		return;				// Error: failed to get battery information
 	
-	if ( xinputBatteryTypeToBatteryType(batteryInformation.BatteryType, batteryType) )
+	xinputBatteryInformationToBatteryInformation( &batteryInformation, hasBattery, batteryType, batteryLevel );
+#endif
+}
+
+// Queries the battery information of both the controller and the headset
+void Controller::updateBattery( unsigned long long int timestampInNs )
+{
+	mNextBatteryUpdateTimeInNs = timestampInNs + mBatteryUpdateIntervalInNs;
+	mNextUpdatedBattery = 0;
+
+	beginChanges( timestampInNs );
+	bool changed = false;
+	for ( unsigned int i=0; i<Battery_Count; ++i )
 	{
-		hasBattery = true;
-		batteryLevel = batteryInformation.BatteryLevel;		
-		if ( batteryLevel>getBatteryLevelMax() )		
-			batteryLevel = getBatteryLevelMax();	// Error: the API is returning non-sense
+		bool hasBattery = false;
+		BatteryType batteryType = BatteryType_Unknown;
+		BYTE batteryLevel = 0;
+		getBatteryInformation( static_cast<BatteryID>(i), hasBattery, batteryType, batteryLevel );
+		changed |= setBatteryInformation( static_cast<BatteryID>(i), hasBattery, batteryType, batteryLevel );
 	}
+	if ( changed )
+		recordBattery( timestampInNs );
+	publishState();
+	endChanges();
+}
+
+// Queries the battery information of the next battery only, so that the ControllerManager 
+// can spread a battery update over several frames. Returns true once all of them have 
+// been queried, which schedules the next battery update
+bool Controller::updateNextBattery( unsigned long long int timestampInNs )
+{
+	BatteryID batteryID = static_cast<BatteryID>( mNextUpdatedBattery );
+	beginChanges( timestampInNs );
+	bool hasBattery = false;
+	BatteryType batteryType = BatteryType_Unknown;
+	BYTE batteryLevel = 0;
+	getBatteryInformation( batteryID, hasBattery, batteryType, batteryLevel );
+	if ( setBatteryInformation( batteryID, hasBattery, batteryType, batteryLevel ) )
+		recordBattery( timestampInNs );
+	publishState();
+	endChanges();
+
+	if ( ++mNextUpdatedBattery<Battery_Count )
+		return false;
+	mNextUpdatedBattery = 0;
+	mNextBatteryUpdateTimeInNs = timestampInNs + mBatteryUpdateIntervalInNs;
+	return true;
+}
+
+// Applies the latest battery information read by the BatteryPoller thread, if it's new
+void Controller::applyBatteryReport( unsigned long long int timestampInNs )
+{
+	unsigned int version = mBatteryPoller->getReportVersion( getControllerIndex() );
+	if ( version==mBatteryReportVersion )
+		return;
+	mBatteryReportVersion = version;
+
+	BatteryPoller::Report report;
+	mBatteryPoller->getReport( getControllerIndex(), report );
+	bool changed = false;
+	for ( unsigned int i=0; i<Battery_Count; ++i )
+	{
+		bool hasBattery = false;
+		BatteryType batteryType = BatteryType_Unknown;
+		BYTE batteryLevel = 0;
+#ifndef _XINPUT_9_1_0
+		// The BatteryIDs match the BATTERY_DEVTYPEs
+		xinputBatteryInformationToBatteryInformation( &report.batteryInformation[i], hasBattery, batteryType, batteryLevel );
 #endif
+		changed |= setBatteryInformation( static_cast<BatteryID>(i), hasBattery, batteryType, batteryLevel );
+	}
+	if ( changed )
+		recordBattery( timestampInNs );
 }
 
-void Controller::setBatteryInformation( BatteryID batteryID, bool hasBattery, BatteryType batteryType, BYTE batteryLevel )
+// Only the reports published from now on are applied. Without a BatteryPoller, 
+// the battery information is queried during the next update
+void Controller::setBatteryPoller( const BatteryPoller* batteryPoller )
+{
+	mBatteryPoller = batteryPoller;
+	if ( mBatteryPoller )
+		mBatteryReportVersion = mBatteryPoller->getReportVersion( getControllerIndex() );
+	else
+		mNextBatteryUpdateTimeInNs = std::min( mNextBatteryUpdateTimeInNs, mUpdateTimestampInNs );
+}
+
+// Returns true if the battery information changed
+bool Controller::setBatteryInformation( BatteryID batteryID, bool hasBattery, BatteryType batteryType, BYTE batteryLevel )
 {
 	if ( batteryID>=Battery_Count )
-		return;	
+		return false;	
 
+	BYTE oldBatteryLevel = mBatteryLevel[batteryID];
 	bool changed = false;
 	if ( hasBattery!=mHasBattery[batteryID] )		// Note: this should never happen for the Controller itself. The battery capabilities should never change over time!
 	{
@@ -544,9 +1104,31 @@ void Controller::setBatteryInformation( BatteryID batteryID, bool hasBattery, Ba
 	// Notify
 	if ( changed )
 	{
-		for ( Listeners::iterator itr=mListeners.begin(); itr!=mListeners.end(); ++itr )
-			(*itr)->onComponentChanged( this, ComponentType_Battery, batteryID );
+		mIsStateDirty = true;
+		notifyComponentChanged( ComponentType_Battery, batteryID, oldBatteryLevel, batteryLevel );
 	}
+	return changed;
+}
+
+// The timestamp of the records made outside of the state packets: that of the update in 
+// progress, so that they come after its packet in the log even when it was read earlier 
+// (by a Sampler for example), the current time otherwise
+unsigned long long int Controller::getRecordTimestampInNs() const
+{
+	return mIsUpdating ? mUpdateTimestampInNs : Timestamp::getTimestampInNs();
+}
+
+// Records the battery information of both the controller and the headset, so that the 
+// replays see it change
+void Controller::recordBattery( unsigned long long int timestampInNs )
+{
+	if ( !mRecorder )
+		return;
+
+	XINPUT_BATTERY_INFORMATION batteryInformation[Battery_Count];
+	for ( unsigned int i=0; i<Battery_Count; ++i )
+		batteryInformationToXInputBatteryInformation( mHasBattery[i], mBatteryType[i], mBatteryLevel[i], &batteryInformation[i] );
+	mRecorder->recordBattery( getControllerIndex(), timestampInNs, batteryInformation );
 }
 
 BYTE Controller::getBatteryLevelMax()
@@ -565,7 +1147,7 @@ bool Controller::getWindowsCoreAudioDeviceIds( std::wstring& renderDeviceId, std
 	renderDeviceId = L"";
 	captureDeviceId = L"";
 
-#ifdef _XINPUT_1_4
+#if defined(_XINPUT_1_4) && defined(_WIN32)
 	// Used hard-coded size for storing the ids as in the example:
 	// http://blogs.msdn.com/b/chuckw/archive/2012/05/03/xinput-and-xaudio2.aspx
 	WCHAR renderID[256] = {0};
@@ -592,7 +1174,7 @@ bool Controller::getDirectSoundAudioDeviceIds( GUID& renderGuid, GUID& captureGu
 	memset( &renderGuid, 0, sizeof(GUID) );
 	memset( &captureGuid, 0, sizeof(GUID) );
 	
-#ifndef _XINPUT_1_4
+#if !defined(_XINPUT_1_4) && defined(_WIN32)
 	// DirectSound info no more available since XInput 1.4
 	if ( XInputGetDSoundAudioDeviceGuids( getControllerIndex(), &renderGuid, &captureGuid )==ERROR_SUCCESS )
 		return true;
@@ -674,6 +1256,121 @@ bool Controller::xinputBatteryTypeToBatteryType( BYTE xinputBatteryType, Control
 #endif
 }
 
+void Controller::xinputBatteryInformationToBatteryInformation( const void* xinputBatteryInformation, bool& hasBattery, BatteryType& batteryType, BYTE& batteryLevel )
+{
+	hasBattery = false;
+	batteryType = BatteryType_Unknown;
+	batteryLevel = 0;
+
+#ifdef _XINPUT_9_1_0
+	// Battery information API not available in XInput 9.1.0
+	UNREFERENCED_PARAMETER(xinputBatteryInformation);
+#else
+	const XINPUT_BATTERY_INFORMATION& batteryInformation = *static_cast<const XINPUT_BATTERY_INFORMATION*>( xinputBatteryInformation );
+	if ( xinputBatteryTypeToBatteryType(batteryInformation.BatteryType, batteryType) )
+	{
+		hasBattery = true;
+		batteryLevel = batteryInformation.BatteryLevel;		
+		if ( batteryLevel>getBatteryLevelMax() )		
+			batteryLevel = getBatteryLevelMax();	// Error: the API is returning non-sense
+	}
+#endif
+}
+
+// The reverse of xinputBatteryInformationToBatteryInformation(): a controller without 
+// battery gets BATTERY_TYPE_DISCONNECTED, which reads back the same
+void Controller::batteryInformationToXInputBatteryInformation( bool hasBattery, BatteryType batteryType, BYTE batteryLevel, void* xinputBatteryInformation )
+{
+	XINPUT_BATTERY_INFORMATION& batteryInformation = *static_cast<XINPUT_BATTERY_INFORMATION*>( xinputBatteryInformation );
+	batteryInformation.BatteryType = BATTERY_TYPE_DISCONNECTED;
+	batteryInformation.BatteryLevel = 0;
+#ifndef _XINPUT_9_1_0
+	if ( !hasBattery )
+		return;
+	switch ( batteryType )
+	{
+		case BatteryType_Alkaline :	batteryInformation.BatteryType = BATTERY_TYPE_ALKALINE; break;
+		case BatteryType_NiMH :		batteryInformation.BatteryType = BATTERY_TYPE_NIMH; break;
+		default :					batteryInformation.BatteryType = BATTERY_TYPE_UNKNOWN; break;
+	}
+	batteryInformation.BatteryLevel = batteryLevel;
+#else
+	UNREFERENCED_PARAMETER(hasBattery);
+	UNREFERENCED_PARAMETER(batteryType);
+	UNREFERENCED_PARAMETER(batteryLevel);
+#endif
+}
+
+// Notifies the listeners of a change, and queues it for the batch listeners
+void Controller::notifyComponentChanged( ComponentTypeID componentTypeID, int componentID, int oldValue, int newValue, int oldValueY, int newValueY )
+{
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+	if ( !mListeners.empty() )
+	{
+		unsigned long long int startTime = Timestamp::getTimestampInNs();
+		if ( mIsUpdating )
+			mLatencyProfile->recordDuration( LatencyProfile::Stage_PacketToListener, startTime - mUpdateTimestampInNs );
+		for ( Listeners::iterator itr=mListeners.begin(); itr!=mListeners.end(); ++itr )
+			(*itr)->onComponentChanged( this, componentTypeID, componentID );
+		mExcludedTimeInNs += mLatencyProfile->record( LatencyProfile::Stage_Dispatch, startTime );
+	}
+#else
+	for ( Listeners::iterator itr=mListeners.begin(); itr!=mListeners.end(); ++itr )
+		(*itr)->onComponentChanged( this, componentTypeID, componentID );
+#endif
+
+	if ( mBatchListeners.empty() )
+		return;
+	ComponentChange change;
+	change.componentTypeID = componentTypeID;
+	change.componentID = componentID;
+	change.oldValue[0] = oldValue;
+	change.oldValue[1] = oldValueY;
+	change.newValue[0] = newValue;
+	change.newValue[1] = newValueY;
+	change.timestampInNs = mChangesTimestampInNs;
+	mPendingChanges.push_back( change );
+}
+
+// Starts accumulating changes for the batch listeners. Calls can be nested
+void Controller::beginChanges( unsigned long long int timestampInNs )
+{
+	if ( mChangesDepth==0 )
+		mChangesTimestampInNs = timestampInNs;
+	++mChangesDepth;
+}
+
+// Delivers the accumulated changes when the outermost call is reached. 
+// Changes made by the batch listeners themselves (setting the vibration 
+// motors for example) are delivered in a subsequent batch
+void Controller::endChanges()
+{
+	if ( mChangesDepth==0 )
+		return;			// Error: unbalanced calls
+	if ( mChangesDepth>1 )
+	{
+		--mChangesDepth;
+		return;
+	}
+
+	while ( !mPendingChanges.empty() )
+	{
+		mDispatchedChanges.swap( mPendingChanges );
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+		unsigned long long int startTime = Timestamp::getTimestampInNs();
+		if ( mIsUpdating )
+			mLatencyProfile->recordDuration( LatencyProfile::Stage_PacketToListener, startTime - mUpdateTimestampInNs );
+#endif
+		for ( BatchListeners::iterator itr=mBatchListeners.begin(); itr!=mBatchListeners.end(); ++itr )
+			(*itr)->onComponentsChanged( this, &mDispatchedChanges[0], mDispatchedChanges.size() );
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+		mExcludedTimeInNs += mLatencyProfile->record( LatencyProfile::Stage_Dispatch, startTime );
+#endif
+		mDispatchedChanges.clear();
+	}
+	mChangesDepth = 0;
+}
+
 void Controller::addListener( Listener* listener )
 {
 	if ( !listener )
@@ -692,4 +1389,22 @@ bool Controller::removeListener( Listener* listener )
 	return true;
 }
 
+void Controller::addBatchListener( BatchListener* listener )
+{
+	if ( !listener )
+		return;
+	mBatchListeners.push_back(listener);
+}
+
+bool Controller::removeBatchListener( BatchListener* listener )
+{
+	if ( !listener )
+		return false;
+	BatchListeners::iterator itr = std::find( mBatchListeners.begin(), mBatchListeners.end(), listener );
+	if ( itr==mBatchListeners.end() )
+		return false;
+	mBatchListeners.erase( itr );
+	return true;
+}
+
 }
\ No newline at end of file
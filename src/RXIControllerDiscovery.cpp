@@ -0,0 +1,161 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXIControllerDiscovery.h"
+
+#include "RXIBackend.h"
+
+#include <chrono>
+
+namespace RXI
+{
+
+ControllerDiscovery::ControllerDiscovery( Backend* backend, DWORD numMaxControllers )
+	:	mBackend(backend),
+		mNumMaxControllers(numMaxControllers),
+		mThread(),
+		mNumDiscoveries(0),
+		mMutex(),
+		mCondition(),
+		mStopRequested(false),
+		mRequests(),
+		mResults(numMaxControllers*2)			// Room for a result per slot, and for the ones given up on
+{
+	mRequests.reserve( mNumMaxControllers );
+}
+
+ControllerDiscovery::~ControllerDiscovery()
+{
+	stop();
+}
+
+bool ControllerDiscovery::start()
+{
+	if ( !mBackend )
+		return false;		// Error: no backend to query
+	if ( !mBackend->isThreadSafe() )
+		return false;		// Error: the backend can't be queried from the discovery thread
+	if ( isRunning() )
+		return false;		// Error: already started
+	mStopRequested = false;
+	mThread = std::thread( &ControllerDiscovery::run, this );
+	return true;
+}
+
+void ControllerDiscovery::stop()
+{
+	if ( !isRunning() )
+		return;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mStopRequested = true;
+	}
+	mCondition.notify_one();
+	mThread.join();
+}
+
+void ControllerDiscovery::requestDiscovery( DWORD controllerIndex, unsigned int requestID )
+{
+	if ( controllerIndex>=mNumMaxControllers )
+		return;		// Error: wrong controller index
+	
+	Request request;
+	request.controllerIndex = controllerIndex;
+	request.requestID = requestID;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mRequests.push_back( request );
+	}
+	mCondition.notify_one();
+}
+
+void ControllerDiscovery::run()
+{
+	std::vector<Request> requests;
+	requests.reserve( mNumMaxControllers );
+	for ( ;; )
+	{
+		// Wait for requests
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			while ( !mStopRequested && mRequests.empty() )
+				mCondition.wait( lock );
+			if ( mStopRequested )
+				return;
+			requests.swap( mRequests );
+		}
+
+		for ( std::size_t i=0; i<requests.size(); ++i )
+		{
+			Result result;
+			discover( requests[i], result );
+			mNumDiscoveries++;
+
+			// The consumer is lagging behind, which can only happen when it keeps giving up 
+			// on requests. We wait for it as the result must not be lost
+			while ( !mResults.push( result ) )
+			{
+				{
+					std::lock_guard<std::mutex> lock( mMutex );
+					if ( mStopRequested )
+						return;
+				}
+				std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+			}
+		}
+		requests.clear();
+	}
+}
+
+void ControllerDiscovery::discover( const Request& request, Result& result )
+{
+	ZeroMemory( &result, sizeof(Result) );
+	result.controllerIndex = request.controllerIndex;
+	result.requestID = request.requestID;
+	result.capabilitiesResult = mBackend->getCapabilities( request.controllerIndex, XINPUT_FLAG_GAMEPAD, &result.capabilities );
+	if ( result.capabilitiesResult!=ERROR_SUCCESS )
+		return;			// Error: failed to read capabilities, the controller is probably gone already
+
+#ifndef _XINPUT_9_1_0
+	for ( BYTE devType=BATTERY_DEVTYPE_GAMEPAD; devType<=BATTERY_DEVTYPE_HEADSET; ++devType )
+	{
+		XINPUT_BATTERY_INFORMATION& batteryInformation = result.batteryInformation[devType];
+		if ( mBackend->getBatteryInformation( request.controllerIndex, devType, &batteryInformation )!=ERROR_SUCCESS )
+		{
+			// Error: same as no battery
+			batteryInformation.BatteryType = BATTERY_TYPE_DISCONNECTED;
+			batteryInformation.BatteryLevel = BATTERY_LEVEL_EMPTY;
+		}
+	}
+#endif
+
+	// Ensure the motors are stopped
+	if ( result.capabilities.Vibration.wLeftMotorSpeed!=0 || result.capabilities.Vibration.wRightMotorSpeed!=0 )
+	{
+		XINPUT_VIBRATION vibration;
+		ZeroMemory( &vibration, sizeof(XINPUT_VIBRATION) );
+		mBackend->setState( request.controllerIndex, &vibration );
+	}
+}
+
+}
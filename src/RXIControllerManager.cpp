@@ -23,35 +23,34 @@
 */
 #include "RXIControllerManager.h"
 
-// XInput must be included after windows.h
-#include <XInput.h>
-
-// Create a define corresponding to the version of XInput (none is officially provided!)
-// Here is some information about XInput versions:
-// http://msdn.microsoft.com/en-us/library/windows/desktop/hh405051(v=vs.85).aspx
-#ifdef XINPUT_DEVSUBTYPE_WHEEL					// Exists only since XInput 1.3 
-	#ifdef XINPUT_DEVSUBTYPE_GUITAR_ALTERNATE	// Exists only since XInput 1.4
-		#define _XINPUT_1_4
-	#else
-		#define _XINPUT_1_3
-	#endif
-#else
-	#define _XINPUT_9_1_0
-#endif
+#include "RXIXInput.h"
+#include "RXIBackend.h"
+#include "RXIBatteryPoller.h"
+#include "RXIControllerDiscovery.h"
+#include "RXIHapticEngine.h"
+#include "RXIDeadZoneKernels.h"
 
 #include <algorithm>
+#include <iterator>
 #include "RXITimestamp.h"
 
 namespace RXI
 {
 
-#ifdef _XINPUT_9_1_0
-	const DWORD ControllerManager::mNumMaxControllers = 4;
-#else
-	const DWORD ControllerManager::mNumMaxControllers = XUSER_MAX_COUNT;
-#endif
-
-unsigned int ControllerManager::mControllerEnumerationIntervalInMs = 1000;	
+// The buffers used by the batch processing, kept from one update to the next to avoid 
+// allocations. The thumbsticks are stored as a structure of arrays, so that the dead 
+// zone kernels can process them in a vectorized way
+struct ControllerManager::BatchBuffers
+{
+	std::vector<XINPUT_STATE>	states;
+	std::vector<bool>			isConnected;
+	std::vector<int>			thumbstickOffsets;		// Where the thumbsticks of each slot are in the arrays below, or -1
+	std::vector<SHORT>			inX;
+	std::vector<SHORT>			inY;
+	std::vector<SHORT>			deadZoneRadius;
+	std::vector<SHORT>			outX;
+	std::vector<SHORT>			outY;
+};
 
 const char*	ControllerManager::mXInputVersionStrings[XInputVersion_Count] = 
 		{
@@ -60,22 +59,83 @@ const char*	ControllerManager::mXInputVersionStrings[XInputVersion_Count] =
 			"1.4",
 		};
 
-ControllerManager::ControllerManager()
-	:	mNextControllerEnumerationTime(0),
+ControllerManager::ControllerManager( Backend* backend )
+	:	mBackend(backend),
+		mOwnsBackend(false),
+		mNumMaxControllers(0),
+		mControllerEnumerationIntervalInMs(1000),
+		mControllerEnumerationBudget(0),
+		mNextControllerEnumerationTimeInNs(0),
+		mNextEnumeratedControllerIndex(0),
 		mControllers(),
-		mListeners()
+		mControllerPool(),
+		mConnectedControllerIndices(),
+		mEnumeratedControllerIndices(),
+		mUpdatedControllerIndices(),
+		mMaintenanceBudgetInUs(0),
+		mDueBatteryUpdates(),
+		mNumDeferredMaintenanceTasks(0),
+		mListeners(),
+		mLatencyProfile(),
+		mRecorder(NULL),
+		mHapticEngine(NULL),
+		mIsHapticEffectPlaying(),
+		mIsVibrationCoalescingEnabled(false),
+		mBatteryUpdateIntervalInMs(10000),
+		mBatteryPoller(NULL),
+		mControllerDiscovery(NULL),
+		mIsControllerConnecting(),
+		mConnectionRequestIDs(),
+		mNumConnectingControllers(0),
+		mIsBatchProcessingEnabled(false),
+		mBatchBuffers(NULL)
 {
+	if ( !mBackend )
+	{
+		mBackend = Backend::createDefaultBackend();
+		mOwnsBackend = true;
+	}
+
+	mNumMaxControllers = mBackend->getMaxNumControllers();
 	mControllers.resize( getMaxNumControllers() );
+	mControllerPool.resize( getMaxNumControllers() );
 	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
+	{
 		mControllers[i] = NULL;
+		mControllerPool[i] = NULL;
+	}
+	mConnectedControllerIndices.reserve( getMaxNumControllers() );
+	mEnumeratedControllerIndices.reserve( getMaxNumControllers() );
+	mUpdatedControllerIndices.reserve( getMaxNumControllers() );
+	mDueBatteryUpdates.reserve( getMaxNumControllers() );
+	mIsControllerConnecting.resize( getMaxNumControllers(), false );
+	mConnectionRequestIDs.resize( getMaxNumControllers(), 0 );
+	mIsHapticEffectPlaying.resize( getMaxNumControllers(), false );
 
 	// Schedule a controller enumeration immediately
-	mNextControllerEnumerationTime = Timestamp::getTimestampInMs();
+	mNextControllerEnumerationTimeInNs = Timestamp::getTimestampInNs();
+	mNextEnumeratedControllerIndex = getMaxNumControllers();
 }
 
 ControllerManager::~ControllerManager()
 {
+	delete mControllerDiscovery;
+	mControllerDiscovery = NULL;
 	deleteAllControllers();
+	delete mBatteryPoller;
+	mBatteryPoller = NULL;
+	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
+	{
+		delete mControllerPool[i];
+		mControllerPool[i] = NULL;
+	}
+
+	delete mBatchBuffers;
+	mBatchBuffers = NULL;
+
+	if ( mOwnsBackend )
+		delete mBackend;
+	mBackend = NULL;
 }
 
 ControllerManager::XInputVersion ControllerManager::getXInputVersion()
@@ -89,26 +149,363 @@ ControllerManager::XInputVersion ControllerManager::getXInputVersion()
 #endif
 }
 
+void ControllerManager::preallocateControllers()
+{
+	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
+	{
+		if ( !mControllerPool[i] )
+			mControllerPool[i] = createController( i );
+	}
+}
+
 void ControllerManager::update()
 {
-	bool enumerateControllers = false;
-	
 	// We check for new controllers only once in a while, as explained here:
 	// http://msdn.microsoft.com/en-us/library/windows/desktop/ee417001(v=vs.85).aspx
 	// "For performance reasons, don't call XInputGetState for an 'empty' user slot every frame. 
 	// We recommend that you space out checks for new controllers every few seconds instead."
-	unsigned int time = Timestamp::getTimestampInMs();
-	if ( time>=mNextControllerEnumerationTime )
+	// A new enumeration doesn't start before the previous one is over
+	unsigned long long int time = Timestamp::getTimestampInNs();
+	if ( time>=mNextControllerEnumerationTimeInNs && mNextEnumeratedControllerIndex>=getMaxNumControllers() )
+	{
+		mNextEnumeratedControllerIndex = 0;
+		mNextControllerEnumerationTimeInNs = time + mControllerEnumerationIntervalInMs*1000000ULL;
+	}
+
+	// Create the Controller objects of the controllers discovered since the last update
+	updateConnectingControllers();
+
+	// Pick the empty slots to probe during this update: the next ones of the enumeration 
+	// in progress, within the budget. With a maintenance budget, they're probed afterwards 
+	mEnumeratedControllerIndices.clear();
+	std::size_t budget = mControllerEnumerationBudget>0 ? mControllerEnumerationBudget : getMaxNumControllers();
+	while ( mMaintenanceBudgetInUs==0 && mNextEnumeratedControllerIndex<getMaxNumControllers() && mEnumeratedControllerIndices.size()<budget )
 	{
-		enumerateControllers = true;
-		mNextControllerEnumerationTime = time + mControllerEnumerationIntervalInMs;
+		DWORD controllerIndex = mNextEnumeratedControllerIndex++;
+		if ( !mControllers[controllerIndex] )
+			mEnumeratedControllerIndices.push_back( controllerIndex );
 	}
 
+	// Go through the connected controllers and the probed slots, in order. The list 
+	// is copied as it changes when a controller gets disconnected during the update
+	mUpdatedControllerIndices.clear();
+	std::merge( mConnectedControllerIndices.begin(), mConnectedControllerIndices.end(), 
+				mEnumeratedControllerIndices.begin(), mEnumeratedControllerIndices.end(), 
+				std::back_inserter(mUpdatedControllerIndices) );
+	
 	// Update controllers
-	for (DWORD i=0; i<getMaxNumControllers(); i++ )
+	if ( mIsBatchProcessingEnabled )
+	{
+		updateControllersInBatch( mUpdatedControllerIndices );
+	}
+	else
+	{
+		for ( std::size_t k=0; k<mUpdatedControllerIndices.size(); ++k )
+			updateController( mUpdatedControllerIndices[k] );		
+	}
+
+	if ( mMaintenanceBudgetInUs>0 )
+		runMaintenanceTasks( time );
+
+	applyHapticVibrations();
+
+	// Send the vibration staged since the last update, including by the listeners 
+	// notified during this one
+	if ( mIsVibrationCoalescingEnabled )
+		flushVibrations();
+}
+
+void ControllerManager::setMaintenanceBudgetInUs( unsigned int budgetInUs )
+{
+	mMaintenanceBudgetInUs = budgetInUs;
+	mNumDeferredMaintenanceTasks = 0;
+	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
+	{
+		if ( mControllerPool[i] )
+			mControllerPool[i]->mIsBatteryUpdateScheduled = ( budgetInUs>0 );
+	}
+}
+
+// Runs the maintenance tasks that are due, by priority, until the update has used up 
+// the maintenance budget. The others stay due and are run by the next updates. A task 
+// is a single backend query, so an update overruns its budget by one query at most
+void ControllerManager::runMaintenanceTasks( unsigned long long int updateStartTimeInNs )
+{
+	unsigned long long int budgetInNs = mMaintenanceBudgetInUs*1000ULL;
+
+	// The battery updates that are due, the most overdue first
+	mDueBatteryUpdates.clear();
+	if ( !mBatteryPoller )
+	{
+		unsigned long long int time = Timestamp::getTimestampInNs();
+		for ( std::size_t k=0; k<mConnectedControllerIndices.size(); ++k )
+		{
+			DWORD controllerIndex = mConnectedControllerIndices[k];
+			unsigned long long int deadline = mControllers[controllerIndex]->mNextBatteryUpdateTimeInNs;
+			if ( deadline<=time )
+				mDueBatteryUpdates.push_back( std::make_pair( deadline, controllerIndex ) );
+		}
+		std::sort( mDueBatteryUpdates.begin(), mDueBatteryUpdates.end() );
+	}
+
+	std::size_t numProbesMax = mControllerEnumerationBudget>0 ? mControllerEnumerationBudget : getMaxNumControllers();
+	std::size_t numProbes = 0;
+	std::size_t numBatteryUpdates = 0;
+	for ( std::size_t numTasks=0; ; ++numTasks )
+	{
+		// Skip the slots connected since the enumeration started
+		while ( mNextEnumeratedControllerIndex<getMaxNumControllers() && mControllers[mNextEnumeratedControllerIndex] )
+			++mNextEnumeratedControllerIndex;
+		bool isProbePending = mNextEnumeratedControllerIndex<getMaxNumControllers() && numProbes<numProbesMax;
+		bool isBatteryUpdatePending = numBatteryUpdates<mDueBatteryUpdates.size();
+		
+		if ( !isProbePending && !isBatteryUpdatePending )
+			break;
+		if ( numTasks>0 && Timestamp::getTimestampInNs()-updateStartTimeInNs>=budgetInNs )
+			break;		// The budget is spent
+
+		// Probing the empty slots for new controllers first
+		if ( isProbePending )
+		{
+			updateController( mNextEnumeratedControllerIndex++ );
+			++numProbes;
+			continue;
+		}
+
+		// Then refreshing the battery information, one battery query per task
+		Controller* controller = mControllers[mDueBatteryUpdates[numBatteryUpdates].second];
+		if ( !controller || controller->updateNextBattery( Timestamp::getTimestampInNs() ) )
+			++numBatteryUpdates;
+	}
+
+	// What's left: the empty slots of the enumeration in progress and the battery queries 
+	// of the controllers still due
+	mNumDeferredMaintenanceTasks = 0;
+	for ( DWORD i=mNextEnumeratedControllerIndex; i<getMaxNumControllers(); ++i )
+	{
+		if ( !mControllers[i] )
+			++mNumDeferredMaintenanceTasks;
+	}
+	for ( std::size_t k=numBatteryUpdates; k<mDueBatteryUpdates.size(); ++k )
+	{
+		Controller* controller = mControllers[mDueBatteryUpdates[k].second];
+		if ( controller )
+			mNumDeferredMaintenanceTasks += Controller::Battery_Count - controller->mNextUpdatedBattery;
+	}
+}
+
+void ControllerManager::setRecorder( InputRecorder* recorder )
+{
+	if ( recorder==mRecorder )
+		return;
+	mRecorder = recorder;
+	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
+	{
+		if ( mControllerPool[i] )
+			mControllerPool[i]->mRecorder = recorder;
+	}
+
+	// The recording starts with the controllers already connected
+	for ( std::size_t k=0; k<mConnectedControllerIndices.size(); ++k )
+		mControllers[mConnectedControllerIndices[k]]->recordConnection();
+}
+
+void ControllerManager::applyHapticVibrations()
+{
+	if ( !mHapticEngine )
+		return;
+	for ( std::size_t k=0; k<mConnectedControllerIndices.size(); ++k )
 	{
-		if ( mControllers[i]!=NULL || enumerateControllers )
-			updateController(i);		
+		DWORD controllerIndex = mConnectedControllerIndices[k];
+		XINPUT_VIBRATION vibration;
+		bool isPlaying = mHapticEngine->getVibration( controllerIndex, vibration );
+
+		// Once the effects are over, the motors are stopped once and left to the game
+		if ( !isPlaying && !mIsHapticEffectPlaying[controllerIndex] )
+			continue;
+		mIsHapticEffectPlaying[controllerIndex] = isPlaying;
+
+		// Compared to the speeds requested last, so that a controller reconnected while 
+		// an effect is playing gets it again
+		Controller* controller = mControllers[controllerIndex];
+		const WORD speeds[Controller::VibrationMotor_Count] = { vibration.wLeftMotorSpeed, vibration.wRightMotorSpeed };
+		bool isChanged = false;
+		for ( int i=0; i<Controller::VibrationMotor_Count; ++i )
+		{
+			Controller::VibrationMotorID motorID = static_cast<Controller::VibrationMotorID>(i);
+			if ( controller->hasVibrationMotor(motorID) && speeds[i]!=controller->mRequestedVibrationMotorSpeed[i] )
+				isChanged = true;
+		}
+		if ( isChanged )
+			controller->setVibration( vibration.wLeftMotorSpeed, vibration.wRightMotorSpeed );
+	}
+}
+
+void ControllerManager::setVibrationCoalescingEnabled( bool enabled )
+{
+	if ( enabled==mIsVibrationCoalescingEnabled )
+		return;
+	if ( !enabled )
+		flushVibrations();
+	mIsVibrationCoalescingEnabled = enabled;
+	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
+	{
+		if ( mControllerPool[i] )
+			mControllerPool[i]->mIsVibrationCoalescingEnabled = enabled;
+	}
+}
+
+void ControllerManager::flushVibrations()
+{
+	for ( std::size_t k=0; k<mConnectedControllerIndices.size(); ++k )
+		mControllers[mConnectedControllerIndices[k]]->flushVibration();
+}
+
+void ControllerManager::setBatteryUpdateIntervalInMs( unsigned int intervalInMs )
+{
+	mBatteryUpdateIntervalInMs = intervalInMs;
+	if ( mBatteryPoller )
+		mBatteryPoller->setIntervalInMs( intervalInMs );
+	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
+	{
+		if ( mControllerPool[i] )
+			mControllerPool[i]->mBatteryUpdateIntervalInNs = intervalInMs*1000000ULL;
+	}
+}
+
+bool ControllerManager::setAsynchronousBatteryPollingEnabled( bool enabled )
+{
+	if ( enabled==isAsynchronousBatteryPollingEnabled() )
+		return true;
+
+	BatteryPoller* batteryPoller = NULL;
+	if ( enabled )
+	{
+		batteryPoller = new BatteryPoller( mBackend, getMaxNumControllers() );
+		if ( !batteryPoller->start() )
+		{
+			delete batteryPoller;
+			return false;		// Error: the backend can't be queried from another thread
+		}
+		batteryPoller->setIntervalInMs( mBatteryUpdateIntervalInMs );
+		for ( std::size_t k=0; k<mConnectedControllerIndices.size(); ++k )
+			batteryPoller->setControllerConnected( mConnectedControllerIndices[k], true );
+	}
+	
+	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
+	{
+		if ( mControllerPool[i] )
+			mControllerPool[i]->setBatteryPoller( batteryPoller );
+	}
+
+	delete mBatteryPoller;
+	mBatteryPoller = batteryPoller;
+	return true;
+}
+
+unsigned long long int ControllerManager::getNumVibrationWritesRequested() const
+{
+	unsigned long long int numWrites = 0;
+	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
+	{
+		if ( mControllerPool[i] )
+			numWrites += mControllerPool[i]->getNumVibrationWritesRequested();
+	}
+	return numWrites;
+}
+
+unsigned long long int ControllerManager::getNumVibrationWritesIssued() const
+{
+	unsigned long long int numWrites = 0;
+	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
+	{
+		if ( mControllerPool[i] )
+			numWrites += mControllerPool[i]->getNumVibrationWritesIssued();
+	}
+	return numWrites;
+}
+
+void ControllerManager::updateControllersInBatch( const std::vector<DWORD>& controllerIndices )
+{
+	if ( !mBatchBuffers )
+		mBatchBuffers = new BatchBuffers();
+	BatchBuffers& buffers = *mBatchBuffers;
+	buffers.states.clear();
+	buffers.isConnected.clear();
+	buffers.thumbstickOffsets.clear();
+	buffers.inX.clear();
+	buffers.inY.clear();
+	buffers.deadZoneRadius.clear();
+	unsigned long long int timestampInNs = Timestamp::getTimestampInNs();
+
+	// Read the state of all the slots and gather the raw thumbstick positions of the 
+	// controllers that are already known and use the floating-point dead zone. 
+	// The others are entirely processed by the Controller itself
+	for ( std::size_t k=0; k<controllerIndices.size(); ++k )
+	{
+		DWORD i = controllerIndices[k];
+		Controller* controller = mControllers[i];
+		
+		XINPUT_STATE state;
+		ZeroMemory( &state, sizeof(XINPUT_STATE) );
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+		unsigned long long int startTime = Timestamp::getTimestampInNs();
+#endif
+		bool isConnected = mBackend->getState( i, &state )==ERROR_SUCCESS;
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+		mLatencyProfile.record( LatencyProfile::Stage_Poll, startTime );
+#endif
+		
+		int thumbstickOffset = -1;
+		if ( isConnected && controller && controller->getThumbstickDeadZoneMethod()==Controller::DeadZoneMethod_FloatingPoint )
+		{
+			thumbstickOffset = static_cast<int>( buffers.inX.size() );
+			buffers.inX.push_back( state.Gamepad.sThumbLX );
+			buffers.inY.push_back( state.Gamepad.sThumbLY );
+			buffers.deadZoneRadius.push_back( controller->getThumbstickDeadZoneRadius(Controller::Thumbstick_Left) );
+			buffers.inX.push_back( state.Gamepad.sThumbRX );
+			buffers.inY.push_back( state.Gamepad.sThumbRY );
+			buffers.deadZoneRadius.push_back( controller->getThumbstickDeadZoneRadius(Controller::Thumbstick_Right) );
+		}
+
+		buffers.states.push_back( state );
+		buffers.isConnected.push_back( isConnected );
+		buffers.thumbstickOffsets.push_back( thumbstickOffset );
+	}
+
+	// Apply the dead zones of all the thumbsticks at once
+	std::size_t numThumbsticks = buffers.inX.size();
+	buffers.outX.resize( numThumbsticks );
+	buffers.outY.resize( numThumbsticks );
+	if ( numThumbsticks>0 )
+	{
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+		unsigned long long int startTime = Timestamp::getTimestampInNs();
+#endif
+		DeadZoneKernels::applyThumbstickDeadZones( &buffers.inX[0], &buffers.inY[0], &buffers.deadZoneRadius[0], &buffers.outX[0], &buffers.outY[0], numThumbsticks );
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+		mLatencyProfile.record( LatencyProfile::Stage_DeadZone, startTime );
+#endif
+	}
+
+	// Update the controllers, in the same order as the regular update
+	for ( std::size_t k=0; k<controllerIndices.size(); ++k )
+	{
+		DWORD controllerIndex = controllerIndices[k];
+		int offset = buffers.thumbstickOffsets[k];
+		Controller* controller = mControllers[controllerIndex];
+		if ( offset<0 || !controller )
+		{
+			updateController( controllerIndex, buffers.isConnected[k] ? &buffers.states[k] : NULL, timestampInNs );
+			continue;
+		}
+
+		SHORT filteredThumbstickPositions[4] = 
+			{
+				buffers.outX[offset], buffers.outY[offset],
+				buffers.outX[offset+1], buffers.outY[offset+1]
+			};
+		controller->update( &buffers.states[k], timestampInNs, filteredThumbstickPositions );
 	}
 }
 
@@ -120,22 +517,54 @@ void ControllerManager::updateController( DWORD controllerIndex )
 	DWORD dwResult;    
 	XINPUT_STATE state;
 	ZeroMemory( &state, sizeof(XINPUT_STATE) );
-	dwResult = XInputGetState( controllerIndex, &state );
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+	unsigned long long int startTime = Timestamp::getTimestampInNs();
+#endif
+	dwResult = mBackend->getState( controllerIndex, &state );
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+	mLatencyProfile.record( LatencyProfile::Stage_Poll, startTime );
+#endif
 
 	if( dwResult==ERROR_SUCCESS )
+		updateController( controllerIndex, &state );
+	else
+		updateController( controllerIndex, NULL );
+}
+
+void ControllerManager::updateController( DWORD controllerIndex, const void* xinputState )
+{
+	updateController( controllerIndex, xinputState, Timestamp::getTimestampInNs() );
+}
+
+void ControllerManager::updateController( DWORD controllerIndex, const void* xinputState, unsigned long long int timestampInNs )
+{
+	if ( controllerIndex>=getMaxNumControllers() )
+		return;		// Error: wrong controller index
+	
+	if( xinputState )
 	{
 		// The controller is connected
 		Controller* controller = getController( controllerIndex );
 		if ( !controller )
 		{
-			// It wasn't connected already, we create the Controller object 
-			controller = addController( controllerIndex, &state );
+			// It wasn't connected already. Find out what it is on the discovery 
+			// thread first, the Controller object is created when it's over
+			if ( mControllerDiscovery )
+			{
+				requestControllerDiscovery( controllerIndex );
+				return;
+			}
+
+			// Or create the Controller object right away
+			for ( Listeners::iterator itr=mListeners.begin(); itr!=mListeners.end(); ++itr )
+				(*itr)->onControllerConnecting( this );
+			controller = addController( controllerIndex, xinputState, timestampInNs );
 			if ( !controller )
 				return;			
 		}
 
 		// Update the Controller object with the current state
-		controller->update( &state );
+		controller->update( xinputState, timestampInNs );
 	}
 	else
 	{
@@ -146,10 +575,35 @@ void ControllerManager::updateController( DWORD controllerIndex )
 			// The controller was connected just before, we delete the object representing it
 			deleteController( controllerIndex );
 		}
+		else if ( mIsControllerConnecting[controllerIndex] )
+		{
+			// It went away before its discovery was over
+			cancelControllerDiscovery( controllerIndex );
+		}
 	}
 }
 
-Controller*	ControllerManager::addController( DWORD controllerIndex, const void* xinputState )
+void ControllerManager::updateControllerBattery( DWORD controllerIndex, unsigned long long int timestampInNs )
+{
+	Controller* controller = getController( controllerIndex );
+	if ( !controller )
+		return;		// Error: no controller connected there
+	controller->updateBattery( timestampInNs );
+}
+
+// Creates the Controller object of a slot, configured as the manager
+Controller* ControllerManager::createController( DWORD controllerIndex )
+{
+	Controller* controller = new Controller( mBackend, controllerIndex, &mLatencyProfile );
+	controller->mIsVibrationCoalescingEnabled = mIsVibrationCoalescingEnabled;
+	controller->mBatteryUpdateIntervalInNs = mBatteryUpdateIntervalInMs*1000000ULL;
+	controller->mBatteryPoller = mBatteryPoller;
+	controller->mIsBatteryUpdateScheduled = ( mMaintenanceBudgetInUs>0 );
+	controller->mRecorder = mRecorder;
+	return controller;
+}
+
+Controller*	ControllerManager::addController( DWORD controllerIndex, const void* xinputState, unsigned long long int timestampInNs, const void* xinputCapabilities, const void* xinputBatteryInformation )
 {
 	if ( controllerIndex>=getMaxNumControllers() )
 		return NULL;		// Error: wrong controller index
@@ -157,8 +611,17 @@ Controller*	ControllerManager::addController( DWORD controllerIndex, const void*
 	if ( mControllers[controllerIndex]!=NULL )
 		return NULL;		// Error: a Controller object for this index already exists
 	
-	Controller*	controller = new Controller( controllerIndex, xinputState );
+	Controller* controller = mControllerPool[controllerIndex];
+	if ( !controller )
+	{
+		controller = createController( controllerIndex );
+		mControllerPool[controllerIndex] = controller;
+	}
+	controller->connect( xinputState, timestampInNs, xinputCapabilities, xinputBatteryInformation );
+	if ( mBatteryPoller )
+		mBatteryPoller->setControllerConnected( controllerIndex, true );
 	mControllers[controllerIndex]=controller;
+	mConnectedControllerIndices.insert( std::lower_bound( mConnectedControllerIndices.begin(), mConnectedControllerIndices.end(), controllerIndex ), controllerIndex );
 
 	// Notify
 	for ( Listeners::iterator itr=mListeners.begin(); itr!=mListeners.end(); ++itr )
@@ -181,8 +644,11 @@ void ControllerManager::deleteController( DWORD controllerIndex )
 	for ( Listeners::iterator itr=mListeners.begin(); itr!=mListeners.end(); ++itr )
 		(*itr)->onControllerDisconnecting( this, controller );
 
-	delete controller;
+	controller->disconnect();		// The object stays in the pool for the next connection
+	if ( mBatteryPoller )
+		mBatteryPoller->setControllerConnected( controllerIndex, false );
 	mControllers[controllerIndex]=NULL;
+	mConnectedControllerIndices.erase( std::lower_bound( mConnectedControllerIndices.begin(), mConnectedControllerIndices.end(), controllerIndex ) );
 
 	// Notify
 	for ( Listeners::iterator itr=mListeners.begin(); itr!=mListeners.end(); ++itr )
@@ -191,13 +657,88 @@ void ControllerManager::deleteController( DWORD controllerIndex )
 
 void ControllerManager::deleteAllControllers()
 {
+	while ( !mConnectedControllerIndices.empty() )
+		deleteController( mConnectedControllerIndices.front() );
+}
+
+bool ControllerManager::setAsynchronousConnectionEnabled( bool enabled )
+{
+	if ( enabled==isAsynchronousConnectionEnabled() )
+		return true;
+
+	if ( enabled )
+	{
+		ControllerDiscovery* controllerDiscovery = new ControllerDiscovery( mBackend, getMaxNumControllers() );
+		if ( !controllerDiscovery->start() )
+		{
+			delete controllerDiscovery;
+			return false;		// Error: the backend can't be queried from another thread
+		}
+		mControllerDiscovery = controllerDiscovery;
+		return true;
+	}
+
+	// Give up on the pending discoveries. These controllers are connected 
+	// synchronously by the enumeration, which is done on the next update
+	delete mControllerDiscovery;
+	mControllerDiscovery = NULL;
 	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
 	{
-		if ( mControllers[i] )
-			deleteController(i);
+		if ( mIsControllerConnecting[i] )
+			cancelControllerDiscovery( i );
+	}
+	mNextControllerEnumerationTimeInNs = Timestamp::getTimestampInNs();
+	return true;
+}
+
+void ControllerManager::updateConnectingControllers()
+{
+	if ( !mControllerDiscovery )
+		return;
+
+	ControllerDiscovery::Result result;
+	while ( mControllerDiscovery->popResult( result ) )
+	{
+		DWORD controllerIndex = result.controllerIndex;
+		if ( !mIsControllerConnecting[controllerIndex] || result.requestID!=mConnectionRequestIDs[controllerIndex] )
+			continue;		// The request was given up on in the meantime
+		mIsControllerConnecting[controllerIndex] = false;
+		mNumConnectingControllers--;
+		if ( result.capabilitiesResult!=ERROR_SUCCESS )
+			continue;		// Error: the next enumeration will try again
+
+		// The controller might have gone away during the discovery
+		XINPUT_STATE state;
+		ZeroMemory( &state, sizeof(XINPUT_STATE) );
+		if ( mBackend->getState( controllerIndex, &state )!=ERROR_SUCCESS )
+			continue;
+		addController( controllerIndex, &state, Timestamp::getTimestampInNs(), &result.capabilities, result.batteryInformation );
 	}
 }
 
+void ControllerManager::requestControllerDiscovery( DWORD controllerIndex )
+{
+	if ( mIsControllerConnecting[controllerIndex] )
+		return;			// Already requested
+
+	mIsControllerConnecting[controllerIndex] = true;
+	mNumConnectingControllers++;
+	mConnectionRequestIDs[controllerIndex]++;
+
+	// Notify
+	for ( Listeners::iterator itr=mListeners.begin(); itr!=mListeners.end(); ++itr )
+		(*itr)->onControllerConnecting( this );
+
+	mControllerDiscovery->requestDiscovery( controllerIndex, mConnectionRequestIDs[controllerIndex] );
+}
+
+void ControllerManager::cancelControllerDiscovery( DWORD controllerIndex )
+{
+	mIsControllerConnecting[controllerIndex] = false;
+	mNumConnectingControllers--;
+	mConnectionRequestIDs[controllerIndex]++;		// Its result will be ignored
+}
+
 void ControllerManager::addListener( Listener* listener )
 {
 	if ( !listener )
@@ -0,0 +1,242 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXIDeadZoneKernels.h"
+
+#include "RXIController.h"
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP>=2 )
+	#define RXI_HAS_SSE2
+	#include <emmintrin.h>
+#endif
+
+// The AVX2 version is compiled with a per-function target attribute (GCC, Clang) or 
+// without any special flag (MSVC) so that it is available even when the rest of the 
+// library targets an older CPU. It is only used when the CPU supports it
+#if defined(RXI_HAS_SSE2) && ( defined(__GNUC__) || defined(__clang__) )
+	#define RXI_HAS_AVX2
+	#define RXI_AVX2_FUNCTION __attribute__((target("avx2")))
+	#include <immintrin.h>
+#elif defined(RXI_HAS_SSE2) && defined(_MSC_VER)
+	#define RXI_HAS_AVX2
+	#define RXI_AVX2_FUNCTION
+	#include <immintrin.h>
+	#include <intrin.h>
+#endif
+
+namespace RXI
+{
+
+const char* DeadZoneKernels::mInstructionSetNames[InstructionSet_Count] = { "Scalar", "SSE2", "AVX2" };
+
+DeadZoneKernels::InstructionSet DeadZoneKernels::mInstructionSet = DeadZoneKernels::getBestInstructionSet();
+
+bool DeadZoneKernels::isInstructionSetSupported( InstructionSet instructionSet )
+{
+	switch ( instructionSet )
+	{
+		case InstructionSet_Scalar:
+			return true;
+		case InstructionSet_SSE2:
+#ifdef RXI_HAS_SSE2
+			return true;
+#else
+			return false;
+#endif
+		case InstructionSet_AVX2:
+#if defined(RXI_HAS_AVX2) && defined(_MSC_VER)
+		{
+			// AVX2 support from the CPU and AVX registers saving by the OS 
+			int info[4];
+			__cpuid( info, 0 );
+			if ( info[0]<7 )
+				return false;
+			__cpuid( info, 1 );
+			if ( (info[2] & (1<<27))==0 )	// OSXSAVE
+				return false;
+			if ( (_xgetbv(0) & 6)!=6 )
+				return false;
+			__cpuidex( info, 7, 0 );
+			return ( info[1] & (1<<5) )!=0;
+		}
+#elif defined(RXI_HAS_AVX2)
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2")!=0;
+#else
+			return false;
+#endif
+		default:
+			return false;
+	}
+}
+
+bool DeadZoneKernels::setInstructionSet( InstructionSet instructionSet )
+{
+	if ( !isInstructionSetSupported(instructionSet) )
+		return false;
+	mInstructionSet = instructionSet;
+	return true;
+}
+
+DeadZoneKernels::InstructionSet DeadZoneKernels::getBestInstructionSet()
+{
+	if ( isInstructionSetSupported(InstructionSet_AVX2) )
+		return InstructionSet_AVX2;
+	if ( isInstructionSetSupported(InstructionSet_SSE2) )
+		return InstructionSet_SSE2;
+	return InstructionSet_Scalar;
+}
+
+void DeadZoneKernels::applyThumbstickDeadZones( const SHORT* inX, const SHORT* inY, const SHORT* deadZoneRadius, SHORT* outX, SHORT* outY, std::size_t count )
+{
+	switch ( mInstructionSet )
+	{
+		case InstructionSet_AVX2:
+			applyThumbstickDeadZonesAVX2( inX, inY, deadZoneRadius, outX, outY, count );
+			break;
+		case InstructionSet_SSE2:
+			applyThumbstickDeadZonesSSE2( inX, inY, deadZoneRadius, outX, outY, count );
+			break;
+		default:
+			applyThumbstickDeadZonesScalar( inX, inY, deadZoneRadius, outX, outY, count );
+			break;
+	}
+}
+
+void DeadZoneKernels::applyThumbstickDeadZonesScalar( const SHORT* inX, const SHORT* inY, const SHORT* deadZoneRadius, SHORT* outX, SHORT* outY, std::size_t count )
+{
+	for ( std::size_t i=0; i<count; ++i )
+		Controller::applyThumbstickDeadZone( inX[i], inY[i], outX[i], outY[i], deadZoneRadius[i] );
+}
+
+// The vectorized versions perform the same float operations in the same order as 
+// Controller::applyThumbstickDeadZone(), so the results are identical. The branches 
+// are replaced by masks: the values computed for the thumbsticks inside the dead zone 
+// (possibly from a division by a null magnitude) are simply discarded
+#ifdef RXI_HAS_SSE2
+
+void DeadZoneKernels::applyThumbstickDeadZonesSSE2( const SHORT* inX, const SHORT* inY, const SHORT* deadZoneRadius, SHORT* outX, SHORT* outY, std::size_t count )
+{
+	const __m128 maxMagnitude = _mm_set1_ps( static_cast<float>( std::numeric_limits<SHORT>::max() ) );
+	const __m128 zero = _mm_setzero_ps();
+	
+	std::size_t i = 0;
+	for ( ; i+4<=count; i+=4 )
+	{
+		// Load and sign-extend 4 values of each array
+		__m128i rawX = _mm_loadl_epi64( reinterpret_cast<const __m128i*>(inX+i) );
+		__m128i rawY = _mm_loadl_epi64( reinterpret_cast<const __m128i*>(inY+i) );
+		__m128i rawRadius = _mm_loadl_epi64( reinterpret_cast<const __m128i*>(deadZoneRadius+i) );
+		__m128i intX = _mm_srai_epi32( _mm_unpacklo_epi16(rawX, rawX), 16 );
+		__m128i intY = _mm_srai_epi32( _mm_unpacklo_epi16(rawY, rawY), 16 );
+		__m128 x = _mm_cvtepi32_ps( intX );
+		__m128 y = _mm_cvtepi32_ps( intY );
+		__m128 radius = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16(rawRadius, rawRadius), 16 ) );
+
+		__m128 magnitude = _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps(x, x), _mm_mul_ps(y, y) ) );
+		__m128 dirX = _mm_div_ps( x, magnitude );
+		__m128 dirY = _mm_div_ps( y, magnitude );
+		__m128 clippedMagnitude = _mm_min_ps( magnitude, maxMagnitude );
+		__m128 normalizedMagnitude = _mm_div_ps( _mm_sub_ps(clippedMagnitude, radius), _mm_sub_ps(maxMagnitude, radius) );
+		__m128i resultX = _mm_cvttps_epi32( _mm_mul_ps( _mm_mul_ps(dirX, normalizedMagnitude), maxMagnitude ) );
+		__m128i resultY = _mm_cvttps_epi32( _mm_mul_ps( _mm_mul_ps(dirY, normalizedMagnitude), maxMagnitude ) );
+		
+		// Keep the input when there's no dead zone, the result when outside of it, and zero otherwise. 
+		// Nothing is outside of a dead zone as large as the maximum magnitude
+		__m128i noDeadZone = _mm_castps_si128( _mm_cmple_ps(radius, zero) );
+		__m128i outside = _mm_andnot_si128( noDeadZone, _mm_castps_si128( _mm_and_ps( _mm_cmpgt_ps(magnitude, radius), _mm_cmplt_ps(radius, maxMagnitude) ) ) );
+		resultX = _mm_or_si128( _mm_and_si128(outside, resultX), _mm_and_si128(noDeadZone, intX) );
+		resultY = _mm_or_si128( _mm_and_si128(outside, resultY), _mm_and_si128(noDeadZone, intY) );
+
+		// Narrow back to 16 bits. Like the scalar cast, out of range values (only possible 
+		// with a degenerate radius) keep their low bits instead of being saturated
+		resultX = _mm_srai_epi32( _mm_slli_epi32(resultX, 16), 16 );
+		resultY = _mm_srai_epi32( _mm_slli_epi32(resultY, 16), 16 );
+		_mm_storel_epi64( reinterpret_cast<__m128i*>(outX+i), _mm_packs_epi32(resultX, resultX) );
+		_mm_storel_epi64( reinterpret_cast<__m128i*>(outY+i), _mm_packs_epi32(resultY, resultY) );
+	}
+	applyThumbstickDeadZonesScalar( inX+i, inY+i, deadZoneRadius+i, outX+i, outY+i, count-i );
+}
+
+#else
+
+void DeadZoneKernels::applyThumbstickDeadZonesSSE2( const SHORT* inX, const SHORT* inY, const SHORT* deadZoneRadius, SHORT* outX, SHORT* outY, std::size_t count )
+{
+	applyThumbstickDeadZonesScalar( inX, inY, deadZoneRadius, outX, outY, count );
+}
+
+#endif
+
+#ifdef RXI_HAS_AVX2
+
+RXI_AVX2_FUNCTION void DeadZoneKernels::applyThumbstickDeadZonesAVX2( const SHORT* inX, const SHORT* inY, const SHORT* deadZoneRadius, SHORT* outX, SHORT* outY, std::size_t count )
+{
+	const __m256 maxMagnitude = _mm256_set1_ps( static_cast<float>( std::numeric_limits<SHORT>::max() ) );
+	const __m256 zero = _mm256_setzero_ps();
+	
+	std::size_t i = 0;
+	for ( ; i+8<=count; i+=8 )
+	{
+		// Load and sign-extend 8 values of each array
+		__m256i intX = _mm256_cvtepi16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>(inX+i) ) );
+		__m256i intY = _mm256_cvtepi16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>(inY+i) ) );
+		__m256i intRadius = _mm256_cvtepi16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>(deadZoneRadius+i) ) );
+		__m256 x = _mm256_cvtepi32_ps( intX );
+		__m256 y = _mm256_cvtepi32_ps( intY );
+		__m256 radius = _mm256_cvtepi32_ps( intRadius );
+
+		__m256 magnitude = _mm256_sqrt_ps( _mm256_add_ps( _mm256_mul_ps(x, x), _mm256_mul_ps(y, y) ) );
+		__m256 dirX = _mm256_div_ps( x, magnitude );
+		__m256 dirY = _mm256_div_ps( y, magnitude );
+		__m256 clippedMagnitude = _mm256_min_ps( magnitude, maxMagnitude );
+		__m256 normalizedMagnitude = _mm256_div_ps( _mm256_sub_ps(clippedMagnitude, radius), _mm256_sub_ps(maxMagnitude, radius) );
+		__m256i resultX = _mm256_cvttps_epi32( _mm256_mul_ps( _mm256_mul_ps(dirX, normalizedMagnitude), maxMagnitude ) );
+		__m256i resultY = _mm256_cvttps_epi32( _mm256_mul_ps( _mm256_mul_ps(dirY, normalizedMagnitude), maxMagnitude ) );
+		
+		// Keep the input when there's no dead zone, the result when outside of it, and zero otherwise. 
+		// Nothing is outside of a dead zone as large as the maximum magnitude
+		__m256i noDeadZone = _mm256_castps_si256( _mm256_cmp_ps(radius, zero, _CMP_LE_OQ) );
+		__m256i outside = _mm256_andnot_si256( noDeadZone, _mm256_castps_si256( _mm256_and_ps( _mm256_cmp_ps(magnitude, radius, _CMP_GT_OQ), _mm256_cmp_ps(radius, maxMagnitude, _CMP_LT_OQ) ) ) );
+		resultX = _mm256_or_si256( _mm256_and_si256(outside, resultX), _mm256_and_si256(noDeadZone, intX) );
+		resultY = _mm256_or_si256( _mm256_and_si256(outside, resultY), _mm256_and_si256(noDeadZone, intY) );
+
+		// Narrow back to 16 bits, as above. The 256-bit pack works within 128-bit lanes, so pack the two halves instead
+		resultX = _mm256_srai_epi32( _mm256_slli_epi32(resultX, 16), 16 );
+		resultY = _mm256_srai_epi32( _mm256_slli_epi32(resultY, 16), 16 );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(outX+i), _mm_packs_epi32( _mm256_castsi256_si128(resultX), _mm256_extracti128_si256(resultX, 1) ) );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(outY+i), _mm_packs_epi32( _mm256_castsi256_si128(resultY), _mm256_extracti128_si256(resultY, 1) ) );
+	}
+	applyThumbstickDeadZonesSSE2( inX+i, inY+i, deadZoneRadius+i, outX+i, outY+i, count-i );
+}
+
+#else
+
+void DeadZoneKernels::applyThumbstickDeadZonesAVX2( const SHORT* inX, const SHORT* inY, const SHORT* deadZoneRadius, SHORT* outX, SHORT* outY, std::size_t count )
+{
+	applyThumbstickDeadZonesSSE2( inX, inY, deadZoneRadius, outX, outY, count );
+}
+
+#endif
+
+}
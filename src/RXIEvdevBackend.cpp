@@ -0,0 +1,618 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXIEvdevBackend.h"
+
+#include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+namespace RXI
+{
+
+namespace
+{
+
+// The axes we read from the device, with their evdev code
+enum AxisID
+{
+	Axis_LeftX,
+	Axis_LeftY,
+	Axis_RightX,
+	Axis_RightY,
+	Axis_LeftTrigger,
+	Axis_RightTrigger,
+	Axis_Count
+};
+
+const unsigned short axisEvdevCode[Axis_Count] = 
+		{
+			ABS_X,
+			ABS_Y,
+			ABS_RX,
+			ABS_RY,
+			ABS_Z,
+			ABS_RZ
+		};
+
+// Whether a bit is set in a bitmap returned by the EVIOCGBIT/EVIOCGKEY ioctls
+bool testBit( const unsigned char* bitmap, unsigned int bit )
+{
+	return ( bitmap[bit/8] & (1<<(bit%8)) )!=0;
+}
+
+// Maps a key code to the corresponding XInput button bit-mask (or 0 if unsupported)
+WORD keyCodeToButtonMask( unsigned short code )
+{
+	switch ( code )
+	{
+		case BTN_A :				return XINPUT_GAMEPAD_A;
+		case BTN_B :				return XINPUT_GAMEPAD_B;
+		case BTN_X :				return XINPUT_GAMEPAD_X;
+		case BTN_Y :				return XINPUT_GAMEPAD_Y;
+		case BTN_TL :				return XINPUT_GAMEPAD_LEFT_SHOULDER;
+		case BTN_TR :				return XINPUT_GAMEPAD_RIGHT_SHOULDER;
+		case BTN_SELECT :			return XINPUT_GAMEPAD_BACK;
+		case BTN_START :			return XINPUT_GAMEPAD_START;
+		case BTN_THUMBL :			return XINPUT_GAMEPAD_LEFT_THUMB;
+		case BTN_THUMBR :			return XINPUT_GAMEPAD_RIGHT_THUMB;
+		case BTN_DPAD_UP :			return XINPUT_GAMEPAD_DPAD_UP;
+		case BTN_DPAD_DOWN :		return XINPUT_GAMEPAD_DPAD_DOWN;
+		case BTN_DPAD_LEFT :		return XINPUT_GAMEPAD_DPAD_LEFT;
+		case BTN_DPAD_RIGHT :		return XINPUT_GAMEPAD_DPAD_RIGHT;
+		// The xpad driver reports the D-Pad of some devices as extra buttons
+		case BTN_TRIGGER_HAPPY1 :	return XINPUT_GAMEPAD_DPAD_LEFT;
+		case BTN_TRIGGER_HAPPY2 :	return XINPUT_GAMEPAD_DPAD_RIGHT;
+		case BTN_TRIGGER_HAPPY3 :	return XINPUT_GAMEPAD_DPAD_UP;
+		case BTN_TRIGGER_HAPPY4 :	return XINPUT_GAMEPAD_DPAD_DOWN;
+	}
+	return 0;
+}
+
+void setButton( XINPUT_GAMEPAD& gamepad, WORD mask, bool pressed )
+{
+	if ( pressed )
+		gamepad.wButtons |= mask;
+	else
+		gamepad.wButtons &= ~mask;
+}
+
+}
+
+struct EvdevBackend::Device
+{
+	struct AxisRange
+	{
+		int		minimum;
+		int		maximum;
+	};
+
+	Device()
+		:	fd(-1),
+			ownsFd(false),
+			isEventDevice(false),
+			dropping(false),
+			rumbleEffectId(-1),
+			bufferSize(0)
+	{
+		ZeroMemory( &state, sizeof(XINPUT_STATE) );
+		ZeroMemory( &pendingGamepad, sizeof(XINPUT_GAMEPAD) );
+		ZeroMemory( &capabilities, sizeof(XINPUT_CAPABILITIES) );
+		ZeroMemory( &vibration, sizeof(XINPUT_VIBRATION) );
+
+		// Ranges used by the xpad driver, overridden with the actual device ranges when available
+		for ( int i=0; i<Axis_Count; ++i )
+		{
+			axisRanges[i].minimum = -32768;
+			axisRanges[i].maximum = 32767;
+		}
+		axisRanges[Axis_LeftTrigger].minimum = 0;
+		axisRanges[Axis_LeftTrigger].maximum = 255;
+		axisRanges[Axis_RightTrigger].minimum = 0;
+		axisRanges[Axis_RightTrigger].maximum = 255;
+	}
+
+	int						fd;
+	bool					ownsFd;
+	bool					isEventDevice;		// Whether fd is an actual evdev device that supports the ioctls
+	bool					dropping;			// Events are being discarded after a SYN_DROPPED
+	XINPUT_STATE			state;				// The state published on the last SYN_REPORT
+	XINPUT_GAMEPAD			pendingGamepad;		// The state being accumulated until the next SYN_REPORT
+	XINPUT_CAPABILITIES		capabilities;
+	XINPUT_VIBRATION		vibration;
+	int						rumbleEffectId;
+	AxisRange				axisRanges[Axis_Count];
+	unsigned char			buffer[sizeof(struct input_event)];		// Partially read event
+	size_t					bufferSize;
+};
+
+EvdevBackend::EvdevBackend( DWORD numMaxControllers )
+	:	mMutex(),
+		mEpollFd(-1),
+		mDevices(),
+		mChangedControllerIndices()
+{
+	mDevices.resize( numMaxControllers );
+	for ( DWORD i=0; i<numMaxControllers; ++i )
+		mDevices[i] = NULL;
+	mEpollFd = epoll_create1( EPOLL_CLOEXEC );
+}
+
+EvdevBackend::~EvdevBackend()
+{
+	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
+		removeDevice(i);
+	if ( mEpollFd>=0 )
+		close( mEpollFd );
+}
+
+int EvdevBackend::openDevice( const char* path )
+{
+	if ( !path )
+		return -1;
+
+	// Read-write access is needed for force-feedback. Fallback on read-only otherwise
+	int fd = open( path, O_RDWR | O_NONBLOCK | O_CLOEXEC );
+	if ( fd<0 )
+		fd = open( path, O_RDONLY | O_NONBLOCK | O_CLOEXEC );
+	if ( fd<0 )
+		return -1;		// Error: failed to open the device
+
+	std::lock_guard<std::mutex> lock( mMutex );
+	DWORD controllerIndex = 0;
+	while ( controllerIndex<getMaxNumControllers() && mDevices[controllerIndex] )
+		++controllerIndex;
+	if ( controllerIndex>=getMaxNumControllers() || !attachDevice( controllerIndex, fd, true ) )
+	{
+		close( fd );
+		return -1;		// Error: no free slot or not a usable device
+	}
+	return static_cast<int>( controllerIndex );
+}
+
+int EvdevBackend::openDevices()
+{
+	DIR* directory = opendir( "/dev/input" );
+	if ( !directory )
+		return 0;
+
+	std::vector<std::string> paths;
+	struct dirent* entry = NULL;
+	while ( (entry=readdir(directory))!=NULL )
+	{
+		std::string name = entry->d_name;
+		if ( name.compare( 0, 5, "event" )==0 )
+			paths.push_back( "/dev/input/" + name );
+	}
+	closedir( directory );
+	std::sort( paths.begin(), paths.end() );
+
+	int numOpened = 0;
+	for ( std::size_t i=0; i<paths.size(); ++i )
+	{
+		// Only keep the devices exposing the gamepad buttons
+		int fd = open( paths[i].c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC );
+		if ( fd<0 )
+			continue;
+		unsigned char keyBits[KEY_MAX/8 + 1] = {0};
+		bool isGamepad = ioctl( fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits )>=0 && testBit( keyBits, BTN_GAMEPAD );
+		close( fd );
+
+		if ( isGamepad && openDevice( paths[i].c_str() )>=0 )
+			++numOpened;
+	}
+	return numOpened;
+}
+
+bool EvdevBackend::addDevice( DWORD controllerIndex, int fd, bool takeOwnership )
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return attachDevice( controllerIndex, fd, takeOwnership );
+}
+
+void EvdevBackend::removeDevice( DWORD controllerIndex )
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	detachDevice( controllerIndex );
+}
+
+bool EvdevBackend::hasDevice( DWORD controllerIndex ) const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return getConnectedDevice(controllerIndex)!=NULL;
+}
+
+// Must be called with the mutex locked
+bool EvdevBackend::attachDevice( DWORD controllerIndex, int fd, bool takeOwnership )
+{
+	if ( controllerIndex>=getMaxNumControllers() )
+		return false;		// Error: wrong controller index
+	if ( mDevices[controllerIndex] )
+		return false;		// Error: a device is already attached to this slot
+	if ( fd<0 || mEpollFd<0 )
+		return false;
+
+	int flags = fcntl( fd, F_GETFL );
+	if ( flags<0 || fcntl( fd, F_SETFL, flags | O_NONBLOCK )<0 )
+		return false;
+
+	struct epoll_event epollEvent;
+	ZeroMemory( &epollEvent, sizeof(epollEvent) );
+	epollEvent.events = EPOLLIN;
+	epollEvent.data.u32 = controllerIndex;
+	if ( epoll_ctl( mEpollFd, EPOLL_CTL_ADD, fd, &epollEvent )<0 )
+		return false;
+
+	Device* device = new Device();
+	device->fd = fd;
+	device->ownsFd = takeOwnership;
+
+	// A gamepad with all its buttons, triggers and sticks, no motor unless 
+	// the device tells us otherwise
+	XINPUT_CAPABILITIES& capabilities = device->capabilities;
+	capabilities.Type = XINPUT_DEVTYPE_GAMEPAD;
+	capabilities.SubType = XINPUT_DEVSUBTYPE_GAMEPAD;
+	capabilities.Gamepad.wButtons = 0xF3FF;
+	capabilities.Gamepad.bLeftTrigger = 0xFF;
+	capabilities.Gamepad.bRightTrigger = 0xFF;
+	capabilities.Gamepad.sThumbLX = static_cast<SHORT>(0xFFC0);
+	capabilities.Gamepad.sThumbLY = static_cast<SHORT>(0xFFC0);
+	capabilities.Gamepad.sThumbRX = static_cast<SHORT>(0xFFC0);
+	capabilities.Gamepad.sThumbRY = static_cast<SHORT>(0xFFC0);
+
+	// Query the actual device when fd is an evdev device (and not a pipe for example)
+	int version = 0;
+	if ( ioctl( fd, EVIOCGVERSION, &version )>=0 )
+	{
+		device->isEventDevice = true;
+		
+		for ( int i=0; i<Axis_Count; ++i )
+		{
+			struct input_absinfo absInfo;
+			ZeroMemory( &absInfo, sizeof(absInfo) );
+			if ( ioctl( fd, EVIOCGABS(axisEvdevCode[i]), &absInfo )>=0 && absInfo.maximum>absInfo.minimum )
+			{
+				device->axisRanges[i].minimum = absInfo.minimum;
+				device->axisRanges[i].maximum = absInfo.maximum;
+			}
+		}
+
+		unsigned char ffBits[FF_MAX/8 + 1] = {0};
+		if ( ioctl( fd, EVIOCGBIT(EV_FF, sizeof(ffBits)), ffBits )>=0 && testBit( ffBits, FF_RUMBLE ) )
+		{
+			capabilities.Vibration.wLeftMotorSpeed = 0xFF;
+			capabilities.Vibration.wRightMotorSpeed = 0xFF;
+		}
+		
+		resynchronizeDevice( *device );
+		device->state.Gamepad = device->pendingGamepad;
+	}
+
+	mDevices[controllerIndex] = device;
+	notifyChange( controllerIndex );
+	return true;
+}
+
+// Must be called with the mutex locked
+void EvdevBackend::detachDevice( DWORD controllerIndex )
+{
+	if ( controllerIndex>=getMaxNumControllers() )
+		return;			// Error: wrong controller index
+	Device* device = mDevices[controllerIndex];
+	if ( !device )
+		return;
+
+	if ( device->rumbleEffectId>=0 )
+		ioctl( device->fd, EVIOCRMFF, device->rumbleEffectId );
+	if ( mEpollFd>=0 )
+		epoll_ctl( mEpollFd, EPOLL_CTL_DEL, device->fd, NULL );
+	if ( device->ownsFd )
+		close( device->fd );
+	delete device;
+	mDevices[controllerIndex] = NULL;
+	notifyChange( controllerIndex );
+}
+
+int EvdevBackend::waitForEvents( int timeoutInMs, std::vector<DWORD>* changedControllerIndices )
+{
+	if ( mEpollFd<0 )
+		return -1;
+
+	// Don't block if devices have been added or removed since the last call
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if ( !mChangedControllerIndices.empty() )
+			timeoutInMs = 0;
+	}
+
+	const int maxEvents = 16;
+	struct epoll_event epollEvents[maxEvents];
+	int numEvents = epoll_wait( mEpollFd, epollEvents, maxEvents, timeoutInMs );
+	if ( numEvents<0 )
+	{
+		if ( errno!=EINTR )
+			return -1;
+		numEvents = 0;		// Interrupted by a signal, we simply report what we have
+	}
+
+	std::lock_guard<std::mutex> lock( mMutex );
+	for ( int i=0; i<numEvents; ++i )
+	{
+		DWORD controllerIndex = epollEvents[i].data.u32;
+		if ( readDevice( controllerIndex ) )
+			notifyChange( controllerIndex );
+	}
+
+	int numChanged = static_cast<int>( mChangedControllerIndices.size() );
+	if ( changedControllerIndices )
+		changedControllerIndices->swap( mChangedControllerIndices );
+	mChangedControllerIndices.clear();
+	return numChanged;
+}
+
+// Reads all the events available on the device. Returns true if at least one 
+// new state has been published. Must be called with the mutex locked
+bool EvdevBackend::readDevice( DWORD controllerIndex )
+{
+	Device* device = getConnectedDevice( controllerIndex );
+	if ( !device )
+		return false;
+
+	DWORD initialPacketNumber = device->state.dwPacketNumber;
+	const size_t eventSize = sizeof(struct input_event);
+	struct input_event events[64];
+	for ( ;; )
+	{
+		// Complete the event partially read last time, if any
+		unsigned char* data = reinterpret_cast<unsigned char*>(events);
+		memcpy( data, device->buffer, device->bufferSize );
+		ssize_t numBytes = read( device->fd, data + device->bufferSize, sizeof(events) - device->bufferSize );
+		if ( numBytes==0 || (numBytes<0 && errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR) )
+		{
+			// End of file or device error (ENODEV when unplugged): the controller is gone
+			detachDevice( controllerIndex );
+			return false;		// Change already notified by the removal
+		}
+		if ( numBytes<0 )
+			break;				// Nothing more to read
+
+		size_t totalSize = device->bufferSize + static_cast<size_t>(numBytes);
+		size_t numEvents = totalSize / eventSize;
+		for ( size_t i=0; i<numEvents; ++i )
+			processEvent( *device, events[i].type, events[i].code, events[i].value );
+		
+		device->bufferSize = totalSize - numEvents*eventSize;
+		memcpy( device->buffer, data + numEvents*eventSize, device->bufferSize );
+	}
+	return device->state.dwPacketNumber!=initialPacketNumber;
+}
+
+void EvdevBackend::processEvent( Device& device, unsigned short type, unsigned short code, int value )
+{
+	if ( type==EV_SYN )
+	{
+		if ( code==SYN_DROPPED )
+		{
+			// The kernel buffer overflowed: ignore everything until the next 
+			// SYN_REPORT and then query the actual state of the device
+			device.dropping = true;
+		}
+		else if ( code==SYN_REPORT )
+		{
+			if ( device.dropping )
+			{
+				device.dropping = false;
+				resynchronizeDevice( device );
+			}
+			device.state.Gamepad = device.pendingGamepad;
+			device.state.dwPacketNumber++;
+		}
+		return;
+	}
+
+	if ( device.dropping )
+		return;
+
+	XINPUT_GAMEPAD& gamepad = device.pendingGamepad;
+	if ( type==EV_KEY )
+	{
+		WORD mask = keyCodeToButtonMask( code );
+		if ( mask )
+			setButton( gamepad, mask, value!=0 );
+	}
+	else if ( type==EV_ABS )
+	{
+		if ( code==ABS_HAT0X )
+		{
+			setButton( gamepad, XINPUT_GAMEPAD_DPAD_LEFT, value<0 );
+			setButton( gamepad, XINPUT_GAMEPAD_DPAD_RIGHT, value>0 );
+			return;
+		}
+		if ( code==ABS_HAT0Y )
+		{
+			setButton( gamepad, XINPUT_GAMEPAD_DPAD_UP, value<0 );
+			setButton( gamepad, XINPUT_GAMEPAD_DPAD_DOWN, value>0 );
+			return;
+		}
+		
+		for ( int i=0; i<Axis_Count; ++i )
+		{
+			if ( axisEvdevCode[i]!=code )
+				continue;
+
+			// Normalize the value to the XInput range
+			const Device::AxisRange& range = device.axisRanges[i];
+			long long int clamped = std::min( std::max( value, range.minimum ), range.maximum );
+			long long int offset = clamped - range.minimum;
+			long long int span = static_cast<long long int>(range.maximum) - range.minimum;
+			if ( i==Axis_LeftTrigger || i==Axis_RightTrigger )
+			{
+				BYTE position = static_cast<BYTE>( (offset*255) / span );
+				if ( i==Axis_LeftTrigger )
+					gamepad.bLeftTrigger = position;
+				else
+					gamepad.bRightTrigger = position;
+			}
+			else
+			{
+				SHORT position = static_cast<SHORT>( (offset*65535) / span - 32768 );
+				switch ( i )
+				{
+					// The Y axes point downward in evdev and upward in XInput
+					case Axis_LeftX :	gamepad.sThumbLX = position; break;
+					case Axis_LeftY :	gamepad.sThumbLY = static_cast<SHORT>( -1-position ); break;
+					case Axis_RightX :	gamepad.sThumbRX = position; break;
+					case Axis_RightY :	gamepad.sThumbRY = static_cast<SHORT>( -1-position ); break;
+				}
+			}
+			return;
+		}
+	}
+}
+
+// Queries the current state of the buttons and axes from the device itself.
+// Only possible with actual evdev devices
+void EvdevBackend::resynchronizeDevice( Device& device )
+{
+	if ( !device.isEventDevice )
+		return;
+
+	unsigned char keyBits[KEY_MAX/8 + 1] = {0};
+	if ( ioctl( device.fd, EVIOCGKEY(sizeof(keyBits)), keyBits )>=0 )
+	{
+		for ( unsigned short code=BTN_MISC; code<=KEY_MAX; ++code )
+		{
+			WORD mask = keyCodeToButtonMask( code );
+			if ( mask )
+				setButton( device.pendingGamepad, mask, testBit( keyBits, code ) );
+		}
+	}
+
+	const unsigned short absCodes[] = { ABS_X, ABS_Y, ABS_RX, ABS_RY, ABS_Z, ABS_RZ, ABS_HAT0X, ABS_HAT0Y };
+	for ( std::size_t i=0; i<sizeof(absCodes)/sizeof(absCodes[0]); ++i )
+	{
+		struct input_absinfo absInfo;
+		ZeroMemory( &absInfo, sizeof(absInfo) );
+		if ( ioctl( device.fd, EVIOCGABS(absCodes[i]), &absInfo )>=0 )
+			processEvent( device, EV_ABS, absCodes[i], absInfo.value );
+	}
+}
+
+// Must be called with the mutex locked
+void EvdevBackend::notifyChange( DWORD controllerIndex )
+{
+	if ( std::find( mChangedControllerIndices.begin(), mChangedControllerIndices.end(), controllerIndex )==mChangedControllerIndices.end() )
+		mChangedControllerIndices.push_back( controllerIndex );
+}
+
+// Must be called with the mutex locked
+EvdevBackend::Device* EvdevBackend::getConnectedDevice( DWORD controllerIndex ) const
+{
+	if ( controllerIndex>=getMaxNumControllers() )
+		return NULL;
+	return mDevices[controllerIndex];
+}
+
+DWORD EvdevBackend::getState( DWORD controllerIndex, XINPUT_STATE* state )
+{
+	if ( !state )
+		return ERROR_BAD_ARGUMENTS;
+	std::lock_guard<std::mutex> lock( mMutex );
+	Device* device = getConnectedDevice( controllerIndex );
+	if ( !device )
+		return ERROR_DEVICE_NOT_CONNECTED;
+	*state = device->state;
+	return ERROR_SUCCESS;
+}
+
+DWORD EvdevBackend::getCapabilities( DWORD controllerIndex, DWORD /*flags*/, XINPUT_CAPABILITIES* capabilities )
+{
+	if ( !capabilities )
+		return ERROR_BAD_ARGUMENTS;
+	std::lock_guard<std::mutex> lock( mMutex );
+	Device* device = getConnectedDevice( controllerIndex );
+	if ( !device )
+		return ERROR_DEVICE_NOT_CONNECTED;
+	*capabilities = device->capabilities;
+	return ERROR_SUCCESS;
+}
+
+DWORD EvdevBackend::setState( DWORD controllerIndex, XINPUT_VIBRATION* vibration )
+{
+	if ( !vibration )
+		return ERROR_BAD_ARGUMENTS;
+	std::lock_guard<std::mutex> lock( mMutex );
+	Device* device = getConnectedDevice( controllerIndex );
+	if ( !device )
+		return ERROR_DEVICE_NOT_CONNECTED;
+	
+	device->vibration = *vibration;
+	if ( !device->isEventDevice || device->capabilities.Vibration.wLeftMotorSpeed==0 )
+		return ERROR_SUCCESS;		// No force-feedback on this device, we simply remember the speeds
+
+	// Upload (or update) the rumble effect. The left motor is the low-frequency/strong one
+	struct ff_effect effect;
+	ZeroMemory( &effect, sizeof(effect) );
+	effect.type = FF_RUMBLE;
+	effect.id = static_cast<short>( device->rumbleEffectId );
+	effect.u.rumble.strong_magnitude = vibration->wLeftMotorSpeed;
+	effect.u.rumble.weak_magnitude = vibration->wRightMotorSpeed;
+	effect.replay.length = 0xFFFF;		// Plays until told otherwise
+	if ( ioctl( device->fd, EVIOCSFF, &effect )<0 )
+		return ERROR_DEVICE_NOT_CONNECTED;
+	device->rumbleEffectId = effect.id;
+
+	struct input_event play;
+	ZeroMemory( &play, sizeof(play) );
+	play.type = EV_FF;
+	play.code = static_cast<unsigned short>( effect.id );
+	play.value = ( vibration->wLeftMotorSpeed!=0 || vibration->wRightMotorSpeed!=0 ) ? 1 : 0;
+	if ( write( device->fd, &play, sizeof(play) )!=static_cast<ssize_t>(sizeof(play)) )
+		return ERROR_DEVICE_NOT_CONNECTED;
+	return ERROR_SUCCESS;
+}
+
+DWORD EvdevBackend::getBatteryInformation( DWORD controllerIndex, BYTE devType, XINPUT_BATTERY_INFORMATION* batteryInformation )
+{
+	if ( !batteryInformation )
+		return ERROR_BAD_ARGUMENTS;
+	std::lock_guard<std::mutex> lock( mMutex );
+	Device* device = getConnectedDevice( controllerIndex );
+	if ( !device )
+		return ERROR_DEVICE_NOT_CONNECTED;
+	
+	// Battery levels are not exposed by evdev (they live in sysfs power_supply)
+	batteryInformation->BatteryType = ( devType==BATTERY_DEVTYPE_GAMEPAD ) ? BATTERY_TYPE_WIRED : BATTERY_TYPE_DISCONNECTED;
+	batteryInformation->BatteryLevel = BATTERY_LEVEL_FULL;
+	return ERROR_SUCCESS;
+}
+
+}
@@ -0,0 +1,310 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXIHapticEngine.h"
+
+#include "RXITimestamp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+
+namespace RXI
+{
+
+HapticEffect::HapticEffect()
+	:	waveform(Waveform_Constant),
+		periodInMs(0),
+		durationInMs(0),
+		//startMagnitude(),
+		//endMagnitude(),
+		attackTimeInMs(0),
+		attackLevel(0),
+		fadeTimeInMs(0),
+		fadeLevel(0)
+{
+	for ( int i=0; i<2; ++i )
+	{
+		startMagnitude[i] = 0;
+		endMagnitude[i] = 0;
+	}
+}
+
+HapticEffect HapticEffect::constant( float leftMagnitude, float rightMagnitude, unsigned int durationInMs )
+{
+	HapticEffect effect;
+	effect.durationInMs = durationInMs;
+	effect.startMagnitude[0] = leftMagnitude;
+	effect.startMagnitude[1] = rightMagnitude;
+	effect.endMagnitude[0] = leftMagnitude;
+	effect.endMagnitude[1] = rightMagnitude;
+	return effect;
+}
+
+HapticEffect HapticEffect::ramp( float startMagnitude, float endMagnitude, unsigned int durationInMs )
+{
+	HapticEffect effect;
+	effect.durationInMs = durationInMs;
+	for ( int i=0; i<2; ++i )
+	{
+		effect.startMagnitude[i] = startMagnitude;
+		effect.endMagnitude[i] = endMagnitude;
+	}
+	return effect;
+}
+
+HapticEffect HapticEffect::periodic( Waveform waveform, float magnitude, unsigned int periodInMs, unsigned int durationInMs )
+{
+	HapticEffect effect = constant( magnitude, magnitude, durationInMs );
+	effect.waveform = waveform;
+	effect.periodInMs = periodInMs;
+	return effect;
+}
+
+bool HapticEffect::evaluate( unsigned long long int timeInNs, float speeds[2] ) const
+{
+	speeds[0] = 0;
+	speeds[1] = 0;
+	const unsigned long long int nsPerMs = 1000000ULL;
+	unsigned long long int durationInNs = durationInMs*nsPerMs;
+	if ( durationInMs>0 && timeInNs>=durationInNs )
+		return false;
+
+	// Waveform. The phase is computed on integers, whatever the time
+	float value = 1;
+	if ( waveform!=Waveform_Constant && periodInMs>0 )
+	{
+		unsigned long long int periodInNs = periodInMs*nsPerMs;
+		float phase = static_cast<float>( static_cast<double>( timeInNs % periodInNs ) / static_cast<double>(periodInNs) );
+		switch ( waveform )
+		{
+			case Waveform_Sine :			value = 0.5f - 0.5f*cosf( 6.2831853f*phase ); break;	// Starts from 0
+			case Waveform_Square :			value = phase<0.5f ? 1.f : 0.f; break;
+			case Waveform_Triangle :		value = phase<0.5f ? 2*phase : 2-2*phase; break;
+			case Waveform_SawtoothUp :		value = phase; break;
+			case Waveform_SawtoothDown :	value = 1-phase; break;
+			default : break;
+		}
+	}
+
+	// Envelope
+	unsigned long long int attackTimeInNs = attackTimeInMs*nsPerMs;
+	if ( timeInNs<attackTimeInNs )
+		value *= attackLevel + (1-attackLevel) * static_cast<float>( static_cast<double>(timeInNs) / static_cast<double>(attackTimeInNs) );
+	unsigned long long int fadeTimeInNs = fadeTimeInMs*nsPerMs;
+	if ( durationInMs>0 && durationInNs-timeInNs<fadeTimeInNs )
+		value *= fadeLevel + (1-fadeLevel) * static_cast<float>( static_cast<double>(durationInNs-timeInNs) / static_cast<double>(fadeTimeInNs) );
+
+	// Magnitude, with the ramp
+	float progress = durationInMs>0 ? static_cast<float>( static_cast<double>(timeInNs) / static_cast<double>(durationInNs) ) : 0;
+	for ( int i=0; i<2; ++i )
+		speeds[i] = value * ( startMagnitude[i] + (endMagnitude[i]-startMagnitude[i])*progress );
+	return true;
+}
+
+HapticEngine::HapticEngine( DWORD numMaxControllers, unsigned int frequencyInHz )
+	:	mNumMaxControllers(numMaxControllers),
+		mFrequencyInHz(frequencyInHz),
+		mThread(),
+		mStopRequested(false),
+		mNumTicks(0),
+		mMutex(),
+		mPlayingEffects(),
+		mNextEffectID(1),
+		mSpeeds(),
+		mHasEffects(),
+		mStagedVibrations( numMaxControllers )
+{
+	if ( mFrequencyInHz==0 )
+		mFrequencyInHz = 1;
+	mPlayingEffects.reserve( 64 );
+	mSpeeds.resize( mNumMaxControllers*2, 0 );
+	mHasEffects.resize( mNumMaxControllers, false );
+	for ( DWORD i=0; i<mNumMaxControllers; ++i )
+		mStagedVibrations[i].store( 0 );
+}
+
+HapticEngine::~HapticEngine()
+{
+	stop();
+}
+
+bool HapticEngine::start()
+{
+	if ( isRunning() )
+		return false;		// Error: already started
+	mStopRequested = false;
+	mThread = std::thread( &HapticEngine::run, this );
+	return true;
+}
+
+void HapticEngine::stop()
+{
+	if ( !isRunning() )
+		return;
+	mStopRequested = true;
+	mThread.join();
+}
+
+HapticEngine::EffectID HapticEngine::play( DWORD controllerIndex, const HapticEffect& effect )
+{
+	if ( controllerIndex>=mNumMaxControllers )
+		return 0;		// Error: wrong controller index
+	
+	PlayingEffect playingEffect;
+	playingEffect.controllerIndex = controllerIndex;
+	playingEffect.startTimeInNs = Timestamp::getTimestampInNs();
+	playingEffect.effect = effect;
+	
+	std::lock_guard<std::mutex> lock( mMutex );
+	playingEffect.effectID = mNextEffectID++;
+	if ( mNextEffectID==0 )
+		mNextEffectID = 1;
+	mPlayingEffects.push_back( playingEffect );
+	return playingEffect.effectID;
+}
+
+bool HapticEngine::stopEffect( EffectID effectID )
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	for ( std::vector<PlayingEffect>::iterator itr=mPlayingEffects.begin(); itr!=mPlayingEffects.end(); ++itr )
+	{
+		if ( itr->effectID==effectID )
+		{
+			mPlayingEffects.erase( itr );
+			return true;
+		}
+	}
+	return false;
+}
+
+void HapticEngine::stopAllEffects( DWORD controllerIndex )
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	std::size_t numEffects = 0;
+	for ( std::size_t i=0; i<mPlayingEffects.size(); ++i )
+	{
+		if ( mPlayingEffects[i].controllerIndex!=controllerIndex )
+			mPlayingEffects[numEffects++] = mPlayingEffects[i];
+	}
+	mPlayingEffects.resize( numEffects );
+}
+
+bool HapticEngine::isPlaying( EffectID effectID ) const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	for ( std::size_t i=0; i<mPlayingEffects.size(); ++i )
+	{
+		if ( mPlayingEffects[i].effectID==effectID )
+			return true;
+	}
+	return false;
+}
+
+std::size_t HapticEngine::getNumPlayingEffects() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mPlayingEffects.size();
+}
+
+void HapticEngine::run()
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::duration period = std::chrono::duration_cast<Clock::duration>( std::chrono::nanoseconds( 1000000000ULL / mFrequencyInHz ) );
+	
+	Clock::time_point nextTickTime = Clock::now();
+	while ( !mStopRequested )
+	{
+		tick();
+
+		// Keep a steady rate, without bursts when late
+		nextTickTime += period;
+		Clock::time_point now = Clock::now();
+		if ( nextTickTime<now )
+			nextTickTime = now;
+		else
+			std::this_thread::sleep_until( nextTickTime );
+	}
+
+	// Let the motors be stopped
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mPlayingEffects.clear();
+	}
+	tick();
+}
+
+void HapticEngine::tick()
+{
+	std::fill( mSpeeds.begin(), mSpeeds.end(), 0.f );
+	std::fill( mHasEffects.begin(), mHasEffects.end(), false );
+	
+	// Add up the effects of each controller and forget those that are over
+	{
+		unsigned long long int time = Timestamp::getTimestampInNs();
+		std::lock_guard<std::mutex> lock( mMutex );
+		std::size_t numEffects = 0;
+		for ( std::size_t i=0; i<mPlayingEffects.size(); ++i )
+		{
+			const PlayingEffect& playingEffect = mPlayingEffects[i];
+			unsigned long long int timeInNs = time>playingEffect.startTimeInNs ? time - playingEffect.startTimeInNs : 0;
+			float speeds[2];
+			if ( !playingEffect.effect.evaluate( timeInNs, speeds ) )
+				continue;
+			mSpeeds[playingEffect.controllerIndex*2] += speeds[0];
+			mSpeeds[playingEffect.controllerIndex*2+1] += speeds[1];
+			mHasEffects[playingEffect.controllerIndex] = true;
+			mPlayingEffects[numEffects++] = playingEffect;
+		}
+		mPlayingEffects.resize( numEffects );
+	}
+
+	// Stage the speeds for the ControllerManager
+	for ( DWORD i=0; i<mNumMaxControllers; ++i )
+	{
+		unsigned long long int stagedVibration = 0;
+		if ( mHasEffects[i] )
+		{
+			float left = std::min( std::max( mSpeeds[i*2], 0.f ), 1.f );
+			float right = std::min( std::max( mSpeeds[i*2+1], 0.f ), 1.f );
+			unsigned long long int leftSpeed = static_cast<WORD>( left*65535.f + 0.5f );
+			unsigned long long int rightSpeed = static_cast<WORD>( right*65535.f + 0.5f );
+			stagedVibration = mPlayingFlag | (leftSpeed << 16) | rightSpeed;
+		}
+		mStagedVibrations[i].store( stagedVibration, std::memory_order_relaxed );
+	}
+	mNumTicks++;
+}
+
+bool HapticEngine::getVibration( DWORD controllerIndex, XINPUT_VIBRATION& vibration ) const
+{
+	ZeroMemory( &vibration, sizeof(XINPUT_VIBRATION) );
+	if ( controllerIndex>=mNumMaxControllers )
+		return false;
+	unsigned long long int stagedVibration = mStagedVibrations[controllerIndex].load( std::memory_order_relaxed );
+	vibration.wLeftMotorSpeed = static_cast<WORD>( stagedVibration >> 16 );
+	vibration.wRightMotorSpeed = static_cast<WORD>( stagedVibration );
+	return ( stagedVibration & mPlayingFlag )!=0;
+}
+
+}
@@ -0,0 +1,444 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXIInputCodec.h"
+
+#include <string.h>
+
+namespace RXI
+{
+
+// The most bytes a record or a keyframe controller takes once encoded
+static const std::size_t maxEncodedRecordSize = 64;
+
+
+// The controller indices from this value on follow the tag byte
+static const unsigned int controllerIndexEscape = 31;
+
+static const unsigned int maxControllerIndex = 0xFFFF;
+
+// The fields of a state that changed, in the byte preceding them
+enum StateField
+{
+	StateField_Buttons = 1<<0,
+	StateField_LeftTrigger = 1<<1,
+	StateField_RightTrigger = 1<<2,
+	StateField_LeftThumbX = 1<<3,
+	StateField_LeftThumbY = 1<<4,
+	StateField_RightThumbX = 1<<5,
+	StateField_RightThumbY = 1<<6
+};
+
+static inline unsigned char* writeVarint( unsigned char* p, unsigned long long int value )
+{
+	while ( value>=0x80 )
+	{
+		*p++ = static_cast<unsigned char>( value | 0x80 );
+		value >>= 7;
+	}
+	*p++ = static_cast<unsigned char>( value );
+	return p;
+}
+
+// Most values fit in a byte: that case is handled first, without looping
+static inline unsigned long long int readVarint( const unsigned char*& p )
+{
+	unsigned long long int value = *p++;
+	if ( value<0x80 )
+		return value;
+	value &= 0x7F;
+	for ( unsigned int shift=7; shift<64; shift+=7 )
+	{
+		unsigned long long int byte = *p++;
+		value |= ( byte & 0x7F ) << shift;
+		if ( byte<0x80 )
+			break;
+	}
+	return value;
+}
+
+static inline unsigned long long int zigzag( long long int value )
+{
+	return ( static_cast<unsigned long long int>(value) << 1 ) ^ static_cast<unsigned long long int>( value >> 63 );
+}
+
+static inline long long int unzigzag( unsigned long long int value )
+{
+	return static_cast<long long int>( value >> 1 ) ^ -static_cast<long long int>( value & 1 );
+}
+
+static inline unsigned char* encodeThumbstickAxis( unsigned char* p, SHORT value, SHORT previousValue )
+{
+	return writeVarint( p, zigzag( static_cast<SHORT>( value - previousValue ) ) );
+}
+
+static inline void decodeThumbstickAxis( const unsigned char*& p, SHORT& value )
+{
+	value = static_cast<SHORT>( value + unzigzag( readVarint( p ) ) );
+}
+
+static unsigned char* encodeState( unsigned char* p, const XINPUT_STATE& state, const XINPUT_STATE& previousState )
+{
+	const XINPUT_GAMEPAD& gamepad = state.Gamepad;
+	const XINPUT_GAMEPAD& previousGamepad = previousState.Gamepad;
+	unsigned char* fields = p++;
+	p = writeVarint( p, zigzag( static_cast<int>( state.dwPacketNumber - previousState.dwPacketNumber ) ) );
+	unsigned char changedFields = 0;
+	if ( gamepad.wButtons!=previousGamepad.wButtons )
+	{
+		changedFields |= StateField_Buttons;
+		p = writeVarint( p, gamepad.wButtons ^ previousGamepad.wButtons );
+	}
+	if ( gamepad.bLeftTrigger!=previousGamepad.bLeftTrigger )
+	{
+		changedFields |= StateField_LeftTrigger;
+		*p++ = gamepad.bLeftTrigger;
+	}
+	if ( gamepad.bRightTrigger!=previousGamepad.bRightTrigger )
+	{
+		changedFields |= StateField_RightTrigger;
+		*p++ = gamepad.bRightTrigger;
+	}
+	if ( gamepad.sThumbLX!=previousGamepad.sThumbLX )
+	{
+		changedFields |= StateField_LeftThumbX;
+		p = encodeThumbstickAxis( p, gamepad.sThumbLX, previousGamepad.sThumbLX );
+	}
+	if ( gamepad.sThumbLY!=previousGamepad.sThumbLY )
+	{
+		changedFields |= StateField_LeftThumbY;
+		p = encodeThumbstickAxis( p, gamepad.sThumbLY, previousGamepad.sThumbLY );
+	}
+	if ( gamepad.sThumbRX!=previousGamepad.sThumbRX )
+	{
+		changedFields |= StateField_RightThumbX;
+		p = encodeThumbstickAxis( p, gamepad.sThumbRX, previousGamepad.sThumbRX );
+	}
+	if ( gamepad.sThumbRY!=previousGamepad.sThumbRY )
+	{
+		changedFields |= StateField_RightThumbY;
+		p = encodeThumbstickAxis( p, gamepad.sThumbRY, previousGamepad.sThumbRY );
+	}
+	*fields = changedFields;
+	return p;
+}
+
+// Applies the encoded changes to state, which holds the previous state
+static inline void decodeState( const unsigned char*& p, XINPUT_STATE& state )
+{
+	XINPUT_GAMEPAD& gamepad = state.Gamepad;
+	unsigned int changedFields = *p++;
+	state.dwPacketNumber += static_cast<DWORD>( unzigzag( readVarint( p ) ) );
+	if ( changedFields & StateField_Buttons )
+		gamepad.wButtons ^= static_cast<WORD>( readVarint( p ) );
+	if ( changedFields & StateField_LeftTrigger )
+		gamepad.bLeftTrigger = *p++;
+	if ( changedFields & StateField_RightTrigger )
+		gamepad.bRightTrigger = *p++;
+	if ( changedFields & StateField_LeftThumbX )
+		decodeThumbstickAxis( p, gamepad.sThumbLX );
+	if ( changedFields & StateField_LeftThumbY )
+		decodeThumbstickAxis( p, gamepad.sThumbLY );
+	if ( changedFields & StateField_RightThumbX )
+		decodeThumbstickAxis( p, gamepad.sThumbRX );
+	if ( changedFields & StateField_RightThumbY )
+		decodeThumbstickAxis( p, gamepad.sThumbRY );
+}
+
+static inline unsigned char* writeCapabilities( unsigned char* p, const XINPUT_CAPABILITIES& capabilities )
+{
+	memcpy( p, &capabilities, sizeof(XINPUT_CAPABILITIES) );
+	return p + sizeof(XINPUT_CAPABILITIES);
+}
+
+static inline void readCapabilities( const unsigned char*& p, XINPUT_CAPABILITIES& capabilities )
+{
+	memcpy( &capabilities, p, sizeof(XINPUT_CAPABILITIES) );
+	p += sizeof(XINPUT_CAPABILITIES);
+}
+
+static inline unsigned char* writeBatteryInformation( unsigned char* p, const XINPUT_BATTERY_INFORMATION batteryInformation[2] )
+{
+	memcpy( p, batteryInformation, 2*sizeof(XINPUT_BATTERY_INFORMATION) );
+	return p + 2*sizeof(XINPUT_BATTERY_INFORMATION);
+}
+
+static inline void readBatteryInformation( const unsigned char*& p, XINPUT_BATTERY_INFORMATION batteryInformation[2] )
+{
+	memcpy( batteryInformation, p, 2*sizeof(XINPUT_BATTERY_INFORMATION) );
+	p += 2*sizeof(XINPUT_BATTERY_INFORMATION);
+}
+
+static bool isInKeyframe( const InputEncoder::ControllerState& controllerState )
+{
+	static const InputEncoder::ControllerState emptyControllerState;
+	const XINPUT_GAMEPAD& gamepad = controllerState.state.Gamepad;
+	return controllerState.isConnected || controllerState.state.dwPacketNumber!=0 || gamepad.wButtons!=0 || 
+		gamepad.bLeftTrigger!=0 || gamepad.bRightTrigger!=0 || 
+		gamepad.sThumbLX!=0 || gamepad.sThumbLY!=0 || gamepad.sThumbRX!=0 || gamepad.sThumbRY!=0 || 
+		memcmp( &controllerState.capabilities, &emptyControllerState.capabilities, sizeof(XINPUT_CAPABILITIES) )!=0 || 
+		memcmp( controllerState.batteryInformation, emptyControllerState.batteryInformation, sizeof(controllerState.batteryInformation) )!=0;
+}
+
+InputEncoder::ControllerState::ControllerState()
+	:	isConnected(false)
+{
+	ZeroMemory( &state, sizeof(XINPUT_STATE) );
+	ZeroMemory( &capabilities, sizeof(XINPUT_CAPABILITIES) );
+	ZeroMemory( batteryInformation, sizeof(batteryInformation) );
+}
+
+InputEncoder::InputEncoder()
+	:	mControllerStates()
+{
+}
+
+void InputEncoder::reset()
+{
+	mControllerStates.clear();
+}
+
+void InputEncoder::encodeBlock( const Record* records, std::size_t numRecords, std::vector<unsigned char>& block )
+{
+	std::size_t numKeyframeControllers = 0;
+	for ( std::size_t i=0; i<mControllerStates.size(); ++i )
+	{
+		if ( isInKeyframe( mControllerStates[i] ) )
+			++numKeyframeControllers;
+	}
+
+	// Make room for the worst case, the block is shrunk to its actual size at the end
+	block.resize( sizeof(BlockHeader) + maxEncodedRecordSize * ( 1 + numKeyframeControllers + numRecords ) + mBlockPadding );
+	unsigned char* start = &block[0];
+	unsigned char* p = start + sizeof(BlockHeader);
+
+	// Keyframe
+	XINPUT_STATE emptyState;
+	ZeroMemory( &emptyState, sizeof(XINPUT_STATE) );
+	p = writeVarint( p, numKeyframeControllers );
+	for ( std::size_t i=0; i<mControllerStates.size(); ++i )
+	{
+		const ControllerState& controllerState = mControllerStates[i];
+		if ( !isInKeyframe( controllerState ) )
+			continue;
+		p = writeVarint( p, i );
+		*p++ = controllerState.isConnected ? 1 : 0;
+		p = encodeState( p, controllerState.state, emptyState );
+		p = writeCapabilities( p, controllerState.capabilities );
+		p = writeBatteryInformation( p, controllerState.batteryInformation );
+	}
+
+	// Records
+	unsigned long long int previousTimestampInNs = numRecords>0 ? records[0].timestampInNs : 0;
+	for ( std::size_t i=0; i<numRecords; ++i )
+	{
+		const Record& record = records[i];
+		DWORD controllerIndex = record.controllerIndex;
+		if ( controllerIndex>=mControllerStates.size() )
+			mControllerStates.resize( controllerIndex+1 );
+		ControllerState& controllerState = mControllerStates[controllerIndex];
+
+		BYTE type = record.type & 7;
+		if ( controllerIndex<controllerIndexEscape )
+		{
+			*p++ = static_cast<unsigned char>( type | (controllerIndex<<3) );
+		}
+		else
+		{
+			*p++ = static_cast<unsigned char>( type | (controllerIndexEscape<<3) );
+			p = writeVarint( p, controllerIndex );
+		}
+		p = writeVarint( p, zigzag( static_cast<long long int>( record.timestampInNs - previousTimestampInNs ) ) );
+		previousTimestampInNs = record.timestampInNs;
+
+		switch ( type )
+		{
+			case InputRecorder::RecordType_State:
+				{
+					XINPUT_STATE state;
+					state.dwPacketNumber = record.packetNumber;
+					state.Gamepad = record.gamepad;
+					p = encodeState( p, state, controllerState.state );
+					controllerState.state = state;
+					controllerState.isConnected = true;
+				}
+				break;
+
+			case InputRecorder::RecordType_Connection:
+				// The Controller starts from an empty state, without battery until one is recorded
+				controllerState = ControllerState();
+				controllerState.isConnected = true;
+				InputRecorder::getCapabilities( record, controllerState.capabilities );
+				p = writeCapabilities( p, controllerState.capabilities );
+				break;
+
+			case InputRecorder::RecordType_Disconnection:
+				controllerState.isConnected = false;
+				break;
+
+			case InputRecorder::RecordType_Vibration:
+				p = writeVarint( p, record.vibration.wLeftMotorSpeed );
+				p = writeVarint( p, record.vibration.wRightMotorSpeed );
+				break;
+
+			case InputRecorder::RecordType_Battery:
+				controllerState.batteryInformation[BATTERY_DEVTYPE_GAMEPAD] = record.batteryInformation[BATTERY_DEVTYPE_GAMEPAD];
+				controllerState.batteryInformation[BATTERY_DEVTYPE_HEADSET] = record.batteryInformation[BATTERY_DEVTYPE_HEADSET];
+				p = writeBatteryInformation( p, controllerState.batteryInformation );
+				break;
+		}
+	}
+
+	memset( p, 0, mBlockPadding );
+	p += mBlockPadding;
+	block.resize( static_cast<std::size_t>( p - start ) );
+
+	BlockHeader header;
+	header.size = static_cast<unsigned int>( block.size() );
+	header.numRecords = static_cast<unsigned int>( numRecords );
+	header.firstTimestampInNs = numRecords>0 ? records[0].timestampInNs : 0;
+	header.lastTimestampInNs = numRecords>0 ? records[numRecords-1].timestampInNs : 0;
+	memcpy( &block[0], &header, sizeof(BlockHeader) );
+}
+
+InputDecoder::InputDecoder()
+	:	mKeyframe(),
+		mStates()
+{
+}
+
+bool InputDecoder::getBlockHeader( const unsigned char* data, std::size_t size, InputEncoder::BlockHeader& header )
+{
+	if ( size<sizeof(InputEncoder::BlockHeader) )
+		return false;		// Error: truncated
+	memcpy( &header, data, sizeof(InputEncoder::BlockHeader) );
+	if ( header.size<sizeof(InputEncoder::BlockHeader)+InputEncoder::mBlockPadding || header.size>size )
+		return false;		// Error: corrupted or truncated
+	if ( header.numRecords>header.size )
+		return false;		// Error: corrupted, a record takes at least two bytes
+	return true;
+}
+
+bool InputDecoder::decodeBlock( const unsigned char* block, std::size_t size, Record* records )
+{
+	InputEncoder::BlockHeader header;
+	if ( !getBlockHeader( block, size, header ) )
+		return false;		// Error: not a whole block
+
+	// Every record starts before the padding, and can't be read past it
+	const unsigned char* p = block + sizeof(InputEncoder::BlockHeader);
+	const unsigned char* end = block + header.size - InputEncoder::mBlockPadding;
+
+	// Keyframe
+	mKeyframe.clear();
+	unsigned long long int numKeyframeControllers = readVarint( p );
+	for ( unsigned long long int i=0; i<numKeyframeControllers; ++i )
+	{
+		if ( p>=end )
+			return false;	// Error: corrupted
+		unsigned long long int controllerIndex = readVarint( p );
+		if ( controllerIndex>maxControllerIndex )
+			return false;	// Error: corrupted
+		if ( controllerIndex>=mKeyframe.size() )
+			mKeyframe.resize( static_cast<std::size_t>(controllerIndex)+1 );
+		InputEncoder::ControllerState& controllerState = mKeyframe[static_cast<std::size_t>(controllerIndex)];
+		controllerState.isConnected = ( *p++ & 1 )!=0;
+		decodeState( p, controllerState.state );
+		if ( p>=end )
+			return false;	// Error: corrupted
+		readCapabilities( p, controllerState.capabilities );
+		readBatteryInformation( p, controllerState.batteryInformation );
+	}
+	XINPUT_STATE emptyState;
+	ZeroMemory( &emptyState, sizeof(XINPUT_STATE) );
+	mStates.assign( mKeyframe.size(), emptyState );
+	for ( std::size_t i=0; i<mKeyframe.size(); ++i )
+		mStates[i] = mKeyframe[i].state;
+
+	// Records
+	unsigned long long int timestampInNs = header.firstTimestampInNs;
+	for ( unsigned int i=0; i<header.numRecords; ++i )
+	{
+		if ( p>=end )
+			return false;	// Error: corrupted
+		unsigned int tag = *p++;
+		unsigned int type = tag & 7;
+		unsigned long long int controllerIndex = tag >> 3;
+		if ( controllerIndex==controllerIndexEscape )
+		{
+			controllerIndex = readVarint( p );
+			if ( controllerIndex>maxControllerIndex )
+				return false;	// Error: corrupted
+		}
+		timestampInNs += static_cast<unsigned long long int>( unzigzag( readVarint( p ) ) );
+
+		Record& record = records[i];
+		ZeroMemory( &record, sizeof(Record) );
+		record.timestampInNs = timestampInNs;
+		record.controllerIndex = static_cast<WORD>( controllerIndex );
+		record.type = static_cast<BYTE>( type );
+		switch ( type )
+		{
+			case InputRecorder::RecordType_State:
+				{
+					if ( controllerIndex>=mStates.size() )
+						mStates.resize( static_cast<std::size_t>(controllerIndex)+1, emptyState );
+					XINPUT_STATE& state = mStates[static_cast<std::size_t>(controllerIndex)];
+					decodeState( p, state );
+					record.packetNumber = state.dwPacketNumber;
+					record.gamepad = state.Gamepad;
+				}
+				break;
+
+			case InputRecorder::RecordType_Connection:
+				{
+					if ( controllerIndex<mStates.size() )
+						mStates[static_cast<std::size_t>(controllerIndex)] = emptyState;
+					XINPUT_CAPABILITIES capabilities;
+					readCapabilities( p, capabilities );
+					InputRecorder::setCapabilities( record, capabilities );
+				}
+				break;
+
+			case InputRecorder::RecordType_Disconnection:
+				break;
+
+			case InputRecorder::RecordType_Vibration:
+				record.vibration.wLeftMotorSpeed = static_cast<WORD>( readVarint( p ) );
+				record.vibration.wRightMotorSpeed = static_cast<WORD>( readVarint( p ) );
+				break;
+
+			case InputRecorder::RecordType_Battery:
+				readBatteryInformation( p, record.batteryInformation );
+				break;
+
+			default:
+				return false;	// Error: corrupted
+		}
+	}
+	if ( p>end )
+		return false;		// Error: the last record overlaps the padding
+	return true;
+}
+
+}
@@ -0,0 +1,382 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXIInputRecorder.h"
+
+#include "RXIInputCodec.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+namespace RXI
+{
+
+static_assert( sizeof(InputRecorder::Record)==32, "The records are meant to be 32 bytes" );
+static_assert( sizeof(InputRecorder::FileHeader)==64, "The file header is meant to be 64 bytes" );
+static_assert( sizeof(InputRecorder::BlockIndexEntry)==32, "The block index entries are meant to be 32 bytes" );
+
+InputRecorder::InputRecorder()
+	:	
+#ifdef _WIN32
+		mFile(INVALID_HANDLE_VALUE),
+		mFileMapping(NULL),
+#else
+		mFile(-1),
+#endif
+		mMapping(NULL),
+		mCompressedFile(NULL),
+		mEncoder(NULL),
+		mBlockRecords(),
+		mBlock(),
+		mBlockIndex(),
+		mCompressedFileSize(0),
+		mIsBlockWriteFailed(false),
+		mIsGrowFailed(false),
+		mRecords(NULL),
+		mNumBufferedRecords(0),
+		mCapacityInRecords(0),
+		mChunkSizeInRecords(0),
+		mNumRecords(0),
+		mNumDroppedRecords(0),
+		mLastTimestampInNs(0)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+	close();
+}
+
+bool InputRecorder::open( const char* filename, std::size_t chunkSizeInRecords )
+{
+	if ( isOpen() )
+		return false;		// Error: already open
+	if ( !filename || chunkSizeInRecords==0 )
+		return false;		// Error: wrong parameters
+
+#ifdef _WIN32
+	mFile = CreateFileA( filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( mFile==INVALID_HANDLE_VALUE )
+		return false;		// Error: failed to create the file
+#else
+	mFile = ::open( filename, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+	if ( mFile<0 )
+		return false;		// Error: failed to create the file
+#endif
+
+	mChunkSizeInRecords = chunkSizeInRecords;
+	mCapacityInRecords = chunkSizeInRecords;
+	mNumBufferedRecords = 0;
+	mNumRecords = 0;
+	mNumDroppedRecords = 0;
+	mLastTimestampInNs = 0;
+	mIsGrowFailed = false;
+	if ( !map( getFileSize(mCapacityInRecords) ) )
+	{
+		close();
+		return false;		// Error: failed to map the file
+	}
+
+	FileHeader* header = static_cast<FileHeader*>( mMapping );
+	memcpy( header->magic, "RXIREC\0\0", sizeof(header->magic) );
+	header->version = mVersion;
+	header->recordSize = sizeof(Record);
+	header->numRecords = 0;
+	return true;
+}
+
+bool InputRecorder::openCompressed( const char* filename, std::size_t keyframeIntervalInRecords )
+{
+	if ( isOpen() )
+		return false;		// Error: already open
+	if ( !filename || keyframeIntervalInRecords==0 )
+		return false;		// Error: wrong parameters
+
+	mCompressedFile = fopen( filename, "wb" );
+	if ( !mCompressedFile )
+		return false;		// Error: failed to create the file
+
+	mEncoder = new InputEncoder();
+	mBlockRecords.resize( keyframeIntervalInRecords );
+	mRecords = &mBlockRecords[0];
+	mCapacityInRecords = keyframeIntervalInRecords;
+	mNumBufferedRecords = 0;
+	mNumRecords = 0;
+	mNumDroppedRecords = 0;
+	mLastTimestampInNs = 0;
+	mBlockIndex.clear();
+	mCompressedFileSize = sizeof(FileHeader);
+	mIsBlockWriteFailed = false;
+	writeCompressedFileHeader( 0 );
+	return true;
+}
+
+void InputRecorder::close()
+{
+	// Write the final number of records, and remove the unused part of the last chunk
+	if ( isOpen() )
+		flush();
+	unmap();
+
+	if ( mCompressedFile )
+	{
+		writeBlockIndex();
+		fclose( mCompressedFile );
+		mCompressedFile = NULL;
+		delete mEncoder;
+		mEncoder = NULL;
+		mBlockRecords.clear();
+		mBlock.clear();
+		mBlockIndex.clear();
+		mRecords = NULL;
+	}
+	
+#ifdef _WIN32
+	if ( mFile!=INVALID_HANDLE_VALUE )
+	{
+		LARGE_INTEGER fileSize;
+		fileSize.QuadPart = static_cast<LONGLONG>( getFileSize(static_cast<std::size_t>(mNumRecords)) );
+		if ( SetFilePointerEx( mFile, fileSize, NULL, FILE_BEGIN ) )
+			SetEndOfFile( mFile );
+		CloseHandle( mFile );
+		mFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if ( mFile>=0 )
+	{
+		if ( ftruncate( mFile, static_cast<off_t>( getFileSize(static_cast<std::size_t>(mNumRecords)) ) )!=0 )
+		{
+			// Error: the file keeps its zero-filled tail, which the readers ignore
+		}
+		::close( mFile );
+		mFile = -1;
+	}
+#endif
+	mCapacityInRecords = 0;
+}
+
+void InputRecorder::flush()
+{
+	if ( !isOpen() )
+		return;
+	if ( mCompressedFile )
+	{
+		// The pending records make a shorter block
+		writeBlock();
+		writeCompressedFileHeader( 0 );
+		fflush( mCompressedFile );
+		return;
+	}
+	FileHeader* header = static_cast<FileHeader*>( mMapping );
+	header->numRecords = mNumRecords;
+#ifdef _WIN32
+	FlushViewOfFile( mMapping, 0 );
+#else
+	msync( mMapping, static_cast<std::size_t>( getFileSize(mCapacityInRecords) ), MS_ASYNC );
+#endif
+}
+
+void InputRecorder::recordConnection( DWORD controllerIndex, unsigned long long int timestampInNs, const XINPUT_CAPABILITIES& capabilities )
+{
+	Record* record = appendRecord( RecordType_Connection, controllerIndex, timestampInNs );
+	if ( record )
+		setCapabilities( *record, capabilities );
+}
+
+void InputRecorder::recordDisconnection( DWORD controllerIndex, unsigned long long int timestampInNs )
+{
+	appendRecord( RecordType_Disconnection, controllerIndex, timestampInNs );
+}
+
+void InputRecorder::recordVibration( DWORD controllerIndex, unsigned long long int timestampInNs, const XINPUT_VIBRATION& vibration )
+{
+	Record* record = appendRecord( RecordType_Vibration, controllerIndex, timestampInNs );
+	if ( record )
+		record->vibration = vibration;
+}
+
+void InputRecorder::recordBattery( DWORD controllerIndex, unsigned long long int timestampInNs, const XINPUT_BATTERY_INFORMATION batteryInformation[2] )
+{
+	Record* record = appendRecord( RecordType_Battery, controllerIndex, timestampInNs );
+	if ( !record )
+		return;
+	record->batteryInformation[BATTERY_DEVTYPE_GAMEPAD] = batteryInformation[BATTERY_DEVTYPE_GAMEPAD];
+	record->batteryInformation[BATTERY_DEVTYPE_HEADSET] = batteryInformation[BATTERY_DEVTYPE_HEADSET];
+}
+
+void InputRecorder::getCapabilities( const Record& record, XINPUT_CAPABILITIES& capabilities )
+{
+	capabilities.Type = record.device.type;
+	capabilities.SubType = record.device.subType;
+	capabilities.Flags = record.device.flags;
+	capabilities.Gamepad = record.capabilities.gamepad;
+	capabilities.Vibration = record.capabilities.vibration;
+}
+
+void InputRecorder::setCapabilities( Record& record, const XINPUT_CAPABILITIES& capabilities )
+{
+	record.device.type = capabilities.Type;
+	record.device.subType = capabilities.SubType;
+	record.device.flags = capabilities.Flags;
+	record.capabilities.gamepad = capabilities.Gamepad;
+	record.capabilities.vibration = capabilities.Vibration;
+}
+
+// Extends the file by a chunk and maps it again
+bool InputRecorder::grow()
+{
+	if ( !isOpen() )
+		return false;		// Error: not open
+	if ( mCompressedFile )
+	{
+		writeBlock();		// Even if it fails, the block can be reused
+		return true;
+	}
+	
+	// After a failure, remapping the whole file again on each record would only fail the same way
+	if ( mIsGrowFailed )
+		return false;		// Error: the file couldn't grow
+
+	FileHeader* header = static_cast<FileHeader*>( mMapping );
+	header->numRecords = mNumRecords;
+	unmap();
+	std::size_t capacityInRecords = mCapacityInRecords + mChunkSizeInRecords;
+	if ( !map( getFileSize(capacityInRecords) ) )
+	{
+		// Error: keep what was recorded mapped, so that close() can still write its header
+		mIsGrowFailed = true;
+		map( getFileSize(mCapacityInRecords) );
+		return false;
+	}
+	mCapacityInRecords = capacityInRecords;
+	return true;
+}
+
+// Encodes the records of the current block and appends them to the compressed file
+bool InputRecorder::writeBlock()
+{
+	if ( mNumBufferedRecords==0 )
+		return true;
+	
+	// After a failed write, the next blocks are dropped as well: they would follow 
+	// a partially written one, which the readers stop at
+	bool isWritten = false;
+	if ( !mIsBlockWriteFailed )
+	{
+		mEncoder->encodeBlock( mRecords, mNumBufferedRecords, mBlock );
+		isWritten = fwrite( &mBlock[0], mBlock.size(), 1, mCompressedFile )==1;
+		mIsBlockWriteFailed = !isWritten;
+	}
+	if ( isWritten )
+	{
+		BlockIndexEntry entry;
+		entry.offset = mCompressedFileSize;
+		entry.firstRecordIndex = mNumRecords - mNumBufferedRecords;
+		entry.firstTimestampInNs = mRecords[0].timestampInNs;
+		entry.lastTimestampInNs = mRecords[mNumBufferedRecords-1].timestampInNs;
+		mBlockIndex.push_back( entry );
+		mCompressedFileSize += mBlock.size();
+	}
+	else
+	{
+		// Error: the records of the block are lost
+		mNumRecords -= mNumBufferedRecords;
+		mNumDroppedRecords += mNumBufferedRecords;
+	}
+	mNumBufferedRecords = 0;
+	return isWritten;
+}
+
+// Writes the header at the start of the compressed file, and goes back to its end
+void InputRecorder::writeCompressedFileHeader( unsigned long long int blockIndexOffset )
+{
+	FileHeader header;
+	memset( &header, 0, sizeof(FileHeader) );
+	memcpy( header.magic, "RXIRECZ\0", sizeof(header.magic) );
+	header.version = mVersion;
+	header.recordSize = sizeof(Record);
+	header.numRecords = mNumRecords;
+	header.blockIndexOffset = blockIndexOffset;
+	header.numBlocks = blockIndexOffset!=0 ? mBlockIndex.size() : 0;
+	fseek( mCompressedFile, 0, SEEK_SET );
+	fwrite( &header, sizeof(FileHeader), 1, mCompressedFile );
+	fseek( mCompressedFile, 0, SEEK_END );
+}
+
+// Appends the block table to the compressed file, after its last block
+void InputRecorder::writeBlockIndex()
+{
+	if ( mIsBlockWriteFailed || mBlockIndex.empty() )
+		return;		// Error: the readers rebuild the table themselves
+	if ( fwrite( &mBlockIndex[0], sizeof(BlockIndexEntry), mBlockIndex.size(), mCompressedFile )!=mBlockIndex.size() )
+		return;		// Error: same
+	writeCompressedFileHeader( mCompressedFileSize );
+}
+
+bool InputRecorder::map( unsigned long long int fileSize )
+{
+#ifdef _WIN32
+	// The file is extended to the size of the mapping
+	mFileMapping = CreateFileMappingA( mFile, NULL, PAGE_READWRITE, static_cast<DWORD>(fileSize>>32), static_cast<DWORD>(fileSize), NULL );
+	if ( !mFileMapping )
+		return false;
+	mMapping = MapViewOfFile( mFileMapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(fileSize) );
+	if ( !mMapping )
+	{
+		CloseHandle( mFileMapping );
+		mFileMapping = NULL;
+		return false;
+	}
+#else
+	if ( ftruncate( mFile, static_cast<off_t>(fileSize) )!=0 )
+		return false;
+	void* mapping = mmap( NULL, static_cast<std::size_t>(fileSize), PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0 );
+	if ( mapping==MAP_FAILED )
+		return false;
+	mMapping = mapping;
+#endif
+	mRecords = reinterpret_cast<Record*>( static_cast<char*>(mMapping) + sizeof(FileHeader) );
+	return true;
+}
+
+void InputRecorder::unmap()
+{
+	if ( !mMapping )
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile( mMapping );
+	CloseHandle( mFileMapping );
+	mFileMapping = NULL;
+#else
+	munmap( mMapping, static_cast<std::size_t>( getFileSize(mCapacityInRecords) ) );
+#endif
+	mMapping = NULL;
+	mRecords = NULL;
+}
+
+}
@@ -0,0 +1,383 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXIInputRecording.h"
+
+#include <algorithm>
+#include <string.h>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace RXI
+{
+
+static const std::size_t noBlock = static_cast<std::size_t>( -1 );
+
+InputRecording::InputRecording()
+	:	
+#ifdef _WIN32
+		mFile(INVALID_HANDLE_VALUE),
+		mFileMapping(NULL),
+#endif
+		mMapping(NULL),
+		mMappingSize(0),
+		mIsCompressed(false),
+		mNumRecords(0),
+		mBlockIndex(),
+		mRecords(NULL),
+		mFirstRecordIndex(0),
+		mNumLoadedRecords(0),
+		mLoadedBlockIndex(noBlock),
+		mDecodedRecords(),
+		mDecoder(),
+		mKeyframes()
+{
+}
+
+InputRecording::~InputRecording()
+{
+	close();
+}
+
+bool InputRecording::open( const char* filename )
+{
+	if ( isOpen() )
+		return false;		// Error: already open
+	if ( !filename )
+		return false;		// Error: wrong parameter
+
+#ifdef _WIN32
+	mFile = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( mFile==INVALID_HANDLE_VALUE )
+		return false;		// Error: failed to open the file
+	LARGE_INTEGER fileSize;
+	if ( !GetFileSizeEx( mFile, &fileSize ) || fileSize.QuadPart<static_cast<LONGLONG>(sizeof(InputRecorder::FileHeader)) )
+	{
+		close();
+		return false;		// Error: not a recording
+	}
+	mMappingSize = static_cast<std::size_t>( fileSize.QuadPart );
+	mFileMapping = CreateFileMappingA( mFile, NULL, PAGE_READONLY, 0, 0, NULL );
+	if ( mFileMapping )
+		mMapping = MapViewOfFile( mFileMapping, FILE_MAP_READ, 0, 0, 0 );
+#else
+	int file = ::open( filename, O_RDONLY );
+	if ( file<0 )
+		return false;		// Error: failed to open the file
+	struct stat status;
+	if ( fstat( file, &status )!=0 || status.st_size<static_cast<off_t>(sizeof(InputRecorder::FileHeader)) )
+	{
+		::close( file );
+		return false;		// Error: not a recording
+	}
+	mMappingSize = static_cast<std::size_t>( status.st_size );
+	void* mapping = mmap( NULL, mMappingSize, PROT_READ, MAP_SHARED, file, 0 );
+	::close( file );		// The mapping keeps the file open
+	if ( mapping!=MAP_FAILED )
+		mMapping = mapping;
+#endif
+	if ( !mMapping )
+	{
+		close();
+		return false;		// Error: failed to map the file
+	}
+
+	const InputRecorder::FileHeader* header = static_cast<const InputRecorder::FileHeader*>( mMapping );
+	mIsCompressed = memcmp( header->magic, "RXIRECZ\0", sizeof(header->magic) )==0;
+	if ( ( !mIsCompressed && memcmp( header->magic, "RXIREC\0\0", sizeof(header->magic) )!=0 ) || 
+		 header->version!=InputRecorder::mVersion || header->recordSize!=sizeof(Record) )
+	{
+		close();
+		return false;		// Error: not a recording, or an unsupported version
+	}
+	if ( mIsCompressed )
+	{
+		if ( !readBlockIndex() )
+			buildBlockIndex();
+		return true;
+	}
+
+	mRecords = reinterpret_cast<const Record*>( static_cast<const char*>(mMapping) + sizeof(InputRecorder::FileHeader) );
+	std::size_t numRecordsMax = ( mMappingSize - sizeof(InputRecorder::FileHeader) ) / sizeof(Record);
+
+	// The header holds the number of records of the last grow or flush. If the recorder 
+	// wasn't closed, more may follow: the log ends at the first unused record. A closed 
+	// log is truncated to its records, so that's only checked past the end of the file
+	mNumRecords = 0;
+	if ( header->numRecords<=numRecordsMax )
+		mNumRecords = static_cast<std::size_t>( header->numRecords );
+	while ( mNumRecords<numRecordsMax && mRecords[mNumRecords].type!=InputRecorder::RecordType_None )
+		++mNumRecords;
+	mNumLoadedRecords = mNumRecords;
+	return true;
+}
+
+void InputRecording::close()
+{
+#ifdef _WIN32
+	if ( mMapping )
+		UnmapViewOfFile( mMapping );
+	if ( mFileMapping )
+		CloseHandle( mFileMapping );
+	mFileMapping = NULL;
+	if ( mFile!=INVALID_HANDLE_VALUE )
+		CloseHandle( mFile );
+	mFile = INVALID_HANDLE_VALUE;
+#else
+	if ( mMapping )
+		munmap( mMapping, mMappingSize );
+#endif
+	mMapping = NULL;
+	mMappingSize = 0;
+	mIsCompressed = false;
+	mNumRecords = 0;
+	mBlockIndex.clear();
+	mRecords = NULL;
+	mFirstRecordIndex = 0;
+	mNumLoadedRecords = 0;
+	mLoadedBlockIndex = noBlock;
+	mDecodedRecords.clear();
+	mKeyframes.clear();
+}
+
+// Reads the block table written at the end of a compressed log when it was closed
+bool InputRecording::readBlockIndex()
+{
+	const InputRecorder::FileHeader* header = static_cast<const InputRecorder::FileHeader*>( mMapping );
+	unsigned long long int indexOffset = header->blockIndexOffset;
+	unsigned long long int numBlocks = header->numBlocks;
+	if ( indexOffset==0 || numBlocks==0 )
+		return false;		// The log wasn't closed
+	if ( indexOffset<sizeof(InputRecorder::FileHeader) || indexOffset>mMappingSize || 
+		 numBlocks>( mMappingSize-indexOffset ) / sizeof(InputRecorder::BlockIndexEntry) )
+		return false;		// Error: corrupted
+
+	const InputRecorder::BlockIndexEntry* entries = reinterpret_cast<const InputRecorder::BlockIndexEntry*>( static_cast<const char*>(mMapping) + indexOffset );
+	mBlockIndex.assign( entries, entries + numBlocks );
+	for ( std::size_t i=0; i<mBlockIndex.size(); ++i )
+	{
+		const InputRecorder::BlockIndexEntry& entry = mBlockIndex[i];
+		bool isValid = entry.offset>=sizeof(InputRecorder::FileHeader) && entry.offset<indexOffset;
+		if ( i>0 )
+			isValid = isValid && entry.offset>mBlockIndex[i-1].offset && entry.firstRecordIndex>=mBlockIndex[i-1].firstRecordIndex;
+		if ( !isValid )
+		{
+			mBlockIndex.clear();
+			return false;	// Error: corrupted
+		}
+	}
+
+	// The number of records of the last block is in its header
+	const InputRecorder::BlockIndexEntry& lastEntry = mBlockIndex.back();
+	InputEncoder::BlockHeader blockHeader;
+	if ( !InputDecoder::getBlockHeader( static_cast<const unsigned char*>(mMapping) + lastEntry.offset, static_cast<std::size_t>(indexOffset - lastEntry.offset), blockHeader ) )
+	{
+		mBlockIndex.clear();
+		return false;		// Error: corrupted
+	}
+	mNumRecords = static_cast<std::size_t>( lastEntry.firstRecordIndex ) + blockHeader.numRecords;
+	return true;
+}
+
+// Builds the block table of a compressed log from the block headers, up to the first incomplete block
+void InputRecording::buildBlockIndex()
+{
+	const unsigned char* data = static_cast<const unsigned char*>( mMapping );
+	std::size_t offset = sizeof(InputRecorder::FileHeader);
+	std::size_t numRecords = 0;
+	InputEncoder::BlockHeader blockHeader;
+	mBlockIndex.clear();
+	while ( InputDecoder::getBlockHeader( data + offset, mMappingSize - offset, blockHeader ) )
+	{
+		InputRecorder::BlockIndexEntry entry;
+		entry.offset = offset;
+		entry.firstRecordIndex = numRecords;
+		entry.firstTimestampInNs = blockHeader.firstTimestampInNs;
+		entry.lastTimestampInNs = blockHeader.lastTimestampInNs;
+		mBlockIndex.push_back( entry );
+		numRecords += blockHeader.numRecords;
+		offset += blockHeader.size;
+	}
+	mNumRecords = numRecords;
+}
+
+static bool isBeforeBlock( std::size_t recordIndex, const InputRecorder::BlockIndexEntry& entry )
+{
+	return recordIndex<entry.firstRecordIndex;
+}
+
+static bool isBlockBefore( const InputRecorder::BlockIndexEntry& entry, unsigned long long int timestampInNs )
+{
+	return entry.lastTimestampInNs<timestampInNs;
+}
+
+static bool isRecordBefore( const InputRecorder::Record& record, unsigned long long int timestampInNs )
+{
+	return record.timestampInNs<timestampInNs;
+}
+
+// The block holding that record
+std::size_t InputRecording::findBlock( std::size_t index ) const
+{
+	std::vector<InputRecorder::BlockIndexEntry>::const_iterator itr = std::upper_bound( mBlockIndex.begin(), mBlockIndex.end(), index, isBeforeBlock );
+	if ( itr==mBlockIndex.begin() )
+		return 0;
+	return static_cast<std::size_t>( itr - mBlockIndex.begin() ) - 1;
+}
+
+// Decodes the records of a block of a compressed log
+void InputRecording::loadBlock( std::size_t blockIndex ) const
+{
+	if ( blockIndex==mLoadedBlockIndex || blockIndex>=mBlockIndex.size() )
+		return;
+	
+	const InputRecorder::BlockIndexEntry& entry = mBlockIndex[blockIndex];
+	std::size_t firstRecordIndex = static_cast<std::size_t>( entry.firstRecordIndex );
+	std::size_t endRecordIndex = blockIndex+1<mBlockIndex.size() ? static_cast<std::size_t>( mBlockIndex[blockIndex+1].firstRecordIndex ) : mNumRecords;
+	std::size_t numRecords = endRecordIndex - firstRecordIndex;
+	
+	mDecodedRecords.resize( numRecords );
+	const unsigned char* block = static_cast<const unsigned char*>( mMapping ) + entry.offset;
+	std::size_t size = mMappingSize - static_cast<std::size_t>( entry.offset );
+	InputEncoder::BlockHeader blockHeader;
+	bool isDecoded = InputDecoder::getBlockHeader( block, size, blockHeader ) && 
+		blockHeader.numRecords==numRecords && 
+		mDecoder.decodeBlock( block, size, mDecodedRecords.empty() ? NULL : &mDecodedRecords[0] );
+	if ( !isDecoded && numRecords>0 )
+	{
+		// Error: the block is corrupted, its records read as RecordType_None
+		memset( &mDecodedRecords[0], 0, numRecords*sizeof(Record) );
+	}
+
+	mRecords = mDecodedRecords.empty() ? NULL : &mDecodedRecords[0];
+	mFirstRecordIndex = firstRecordIndex;
+	mNumLoadedRecords = numRecords;
+	mLoadedBlockIndex = blockIndex;
+}
+
+std::size_t InputRecording::findRecord( unsigned long long int timestampInNs ) const
+{
+	if ( !mIsCompressed )
+		return static_cast<std::size_t>( std::lower_bound( mRecords, mRecords + mNumRecords, timestampInNs, isRecordBefore ) - mRecords );
+
+	// The first block that ends at or after that time holds the record
+	std::vector<InputRecorder::BlockIndexEntry>::const_iterator itr = std::lower_bound( mBlockIndex.begin(), mBlockIndex.end(), timestampInNs, isBlockBefore );
+	if ( itr==mBlockIndex.end() )
+		return mNumRecords;
+	loadBlock( static_cast<std::size_t>( itr - mBlockIndex.begin() ) );
+	return mFirstRecordIndex + static_cast<std::size_t>( std::lower_bound( mRecords, mRecords + mNumLoadedRecords, timestampInNs, isRecordBefore ) - mRecords );
+}
+
+void InputRecording::getControllerStates( std::size_t index, std::vector<ControllerState>& controllerStates ) const
+{
+	controllerStates.clear();
+	if ( index>mNumRecords )
+		index = mNumRecords;
+
+	// Start from the keyframe of the block in a compressed log
+	if ( mIsCompressed )
+	{
+		std::size_t recordIndex = 0;
+		if ( mNumRecords>0 )
+		{
+			loadBlock( findBlock( index<mNumRecords ? index : mNumRecords-1 ) );
+			controllerStates = mDecoder.getKeyframe();
+			recordIndex = mFirstRecordIndex;
+		}
+		applyRecords( recordIndex, index, controllerStates );
+		return;
+	}
+
+	// Make the keyframes of a plain log up to that record, each from the previous one
+	std::size_t keyframeIndex = index / mKeyframeIntervalInRecords;
+	if ( mKeyframes.empty() )
+		mKeyframes.push_back( std::vector<ControllerState>() );
+	while ( mKeyframes.size()<=keyframeIndex )
+	{
+		std::size_t endIndex = mKeyframes.size() * mKeyframeIntervalInRecords;
+		mKeyframes.push_back( mKeyframes.back() );
+		applyRecords( endIndex - mKeyframeIntervalInRecords, endIndex, mKeyframes.back() );
+	}
+	controllerStates = mKeyframes[keyframeIndex];
+	applyRecords( keyframeIndex * mKeyframeIntervalInRecords, index, controllerStates );
+}
+
+// Updates the states of the controllers with those records
+void InputRecording::applyRecords( std::size_t firstIndex, std::size_t endIndex, std::vector<ControllerState>& controllerStates ) const
+{
+	for ( std::size_t recordIndex=firstIndex; recordIndex<endIndex; ++recordIndex )
+	{
+		const Record& record = getRecord( recordIndex );
+		if ( record.controllerIndex>=controllerStates.size() )
+			controllerStates.resize( record.controllerIndex+1 );
+		ControllerState& controllerState = controllerStates[record.controllerIndex];
+		switch ( record.type )
+		{
+			case InputRecorder::RecordType_State:
+				controllerState.isConnected = true;
+				controllerState.state.dwPacketNumber = record.packetNumber;
+				controllerState.state.Gamepad = record.gamepad;
+				break;
+
+			case InputRecorder::RecordType_Connection:
+				controllerState = ControllerState();
+				controllerState.isConnected = true;
+				InputRecorder::getCapabilities( record, controllerState.capabilities );
+				break;
+
+			case InputRecorder::RecordType_Disconnection:
+				controllerState.isConnected = false;
+				break;
+
+			case InputRecorder::RecordType_Battery:
+				controllerState.batteryInformation[BATTERY_DEVTYPE_GAMEPAD] = record.batteryInformation[BATTERY_DEVTYPE_GAMEPAD];
+				controllerState.batteryInformation[BATTERY_DEVTYPE_HEADSET] = record.batteryInformation[BATTERY_DEVTYPE_HEADSET];
+				break;
+		}
+	}
+}
+
+unsigned long long int InputRecording::getStartTimestampInNs() const
+{
+	if ( mNumRecords==0 )
+		return 0;
+	if ( mIsCompressed )
+		return mBlockIndex.front().firstTimestampInNs;
+	return mRecords[0].timestampInNs;
+}
+
+unsigned long long int InputRecording::getEndTimestampInNs() const
+{
+	if ( mNumRecords==0 )
+		return 0;
+	if ( mIsCompressed )
+		return mBlockIndex.back().lastTimestampInNs;
+	return mRecords[mNumRecords-1].timestampInNs;
+}
+
+}
@@ -0,0 +1,147 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXILatencyProfile.h"
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
+namespace RXI
+{
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+void LatencyHistogram::reset()
+{
+	for ( unsigned int i=0; i<NumBuckets; ++i )
+		mCounts[i] = 0;
+	mCount = 0;
+	mSumInNs = 0;
+	mMinInNs = 0;
+	mMaxInNs = 0;
+}
+
+// The values below NumSubBuckets have a bucket each. The larger ones are 
+// written as mantissa*2^shift with a mantissa in [NumSubBuckets, 2*NumSubBuckets)
+unsigned int LatencyHistogram::getBucketIndex( unsigned int value )
+{
+	if ( value<NumSubBuckets )
+		return value;
+#ifdef _MSC_VER
+	unsigned long highestBit = 0;
+	_BitScanReverse( &highestBit, value );
+#else
+	unsigned int highestBit = 31 - __builtin_clz( value );
+#endif
+	unsigned int shift = static_cast<unsigned int>(highestBit) - NumSubBucketBits;
+	unsigned int mantissa = value >> shift;
+	return (shift+1)*NumSubBuckets + (mantissa-NumSubBuckets);
+}
+
+unsigned long long int LatencyHistogram::getBucketUpperBound( unsigned int bucketIndex )
+{
+	if ( bucketIndex<NumSubBuckets )
+		return bucketIndex;
+	unsigned int shift = bucketIndex/NumSubBuckets - 1;
+	unsigned long long int mantissa = NumSubBuckets + bucketIndex%NumSubBuckets;
+	return ( (mantissa+1) << shift ) - 1;
+}
+
+void LatencyHistogram::record( unsigned long long int durationInNs )
+{
+	unsigned int value = durationInNs>0xFFFFFFFFULL ? 0xFFFFFFFFU : static_cast<unsigned int>( durationInNs );
+	++mCounts[getBucketIndex(value)];
+	if ( mCount==0 || durationInNs<mMinInNs )
+		mMinInNs = durationInNs;
+	if ( durationInNs>mMaxInNs )
+		mMaxInNs = durationInNs;
+	++mCount;
+	mSumInNs += durationInNs;
+}
+
+unsigned long long int LatencyHistogram::getPercentileInNs( double percentile ) const
+{
+	if ( mCount==0 )
+		return 0;
+	if ( percentile<0 )
+		percentile = 0;
+	if ( percentile>100 )
+		percentile = 100;
+
+	// The rank of the value we're looking for, starting from 1
+	unsigned long long int rank = static_cast<unsigned long long int>( percentile/100.0 * static_cast<double>(mCount) + 0.5 );
+	if ( rank<1 )
+		rank = 1;
+	if ( rank>mCount )
+		rank = mCount;
+
+	unsigned long long int count = 0;
+	for ( unsigned int i=0; i<NumBuckets; ++i )
+	{
+		count += mCounts[i];
+		if ( count>=rank )
+		{
+			// The bucket can't tell better than the actual extreme values
+			unsigned long long int value = getBucketUpperBound( i );
+			return value<mMaxInNs ? value : mMaxInNs;
+		}
+	}
+	return mMaxInNs;
+}
+
+const char* LatencyProfile::mStageNames[Stage_Count] = 
+	{
+		"poll",
+		"diff",
+		"dead zone",
+		"dispatch",
+		"packet to listener"
+	};
+
+bool LatencyProfile::isEnabled()
+{
+#ifdef RXI_ENABLE_LATENCY_PROFILING
+	return true;
+#else
+	return false;
+#endif
+}
+
+void LatencyProfile::reset()
+{
+	for ( int i=0; i<Stage_Count; ++i )
+		mHistograms[i].reset();
+}
+
+unsigned long long int LatencyProfile::record( Stage stage, unsigned long long int startTimeInNs )
+{
+	unsigned long long int durationInNs = Timestamp::getTimestampInNs() - startTimeInNs;
+	mHistograms[stage].record( durationInNs );
+	return durationInNs;
+}
+
+}
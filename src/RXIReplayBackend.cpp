@@ -0,0 +1,264 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXIReplayBackend.h"
+
+#include "RXIControllerManager.h"
+#include "RXITimestamp.h"
+
+#include <algorithm>
+
+namespace RXI
+{
+
+ReplayBackend::ReplayBackend( DWORD numMaxControllers )
+	:	SyntheticBackend( numMaxControllers ),
+		mRecording(),
+		mNextRecordIndex(0),
+		mTimeScale(1),
+		mIsStarted(false),
+		mStartTimeInNs(0),
+		mStartReplayedTimestampInNs(0),
+		mStatesMutex(),
+		mStates( numMaxControllers )
+{
+	for ( std::size_t i=0; i<mStates.size(); ++i )
+		ZeroMemory( &mStates[i], sizeof(XINPUT_STATE) );
+}
+
+ReplayBackend::~ReplayBackend()
+{
+	close();
+}
+
+bool ReplayBackend::open( const char* filename )
+{
+	close();
+	return mRecording.open( filename );
+}
+
+void ReplayBackend::close()
+{
+	rewind();
+	mRecording.close();
+}
+
+void ReplayBackend::setTimeScale( double timeScale )
+{
+	if ( timeScale<0 )
+		return;		// Error: wrong parameter
+
+	// Carry on from the current position of the replay at the new pace
+	if ( mIsStarted )
+	{
+		unsigned long long int timeInNs = Timestamp::getTimestampInNs();
+		if ( mTimeScale>0 )
+			mStartReplayedTimestampInNs = getReplayedTimestampInNs( timeInNs );
+		else if ( !isFinished() )
+			mStartReplayedTimestampInNs = mRecording.getRecord( mNextRecordIndex ).timestampInNs;
+		mStartTimeInNs = timeInNs;
+	}
+	mTimeScale = timeScale;
+}
+
+void ReplayBackend::rewind()
+{
+	for ( DWORD i=0; i<getMaxNumControllers(); ++i )
+		disconnectController( i );
+	mNextRecordIndex = 0;
+	mIsStarted = false;
+}
+
+std::size_t ReplayBackend::replay( ControllerManager& manager )
+{
+	if ( isFinished() )
+		return 0;
+	
+	unsigned long long int timeInNs = Timestamp::getTimestampInNs();
+	if ( !mIsStarted )
+	{
+		mIsStarted = true;
+		mStartTimeInNs = timeInNs;
+		mStartReplayedTimestampInNs = mRecording.getRecord( mNextRecordIndex ).timestampInNs;
+	}
+	
+	if ( mTimeScale==0 )
+		return replayAll( manager );
+	return replayUntil( manager, getReplayedTimestampInNs( timeInNs ) );
+}
+
+std::size_t ReplayBackend::replayAll( ControllerManager& manager )
+{
+	return replayUntil( manager, ~0ULL );
+}
+
+std::size_t ReplayBackend::replayUntil( ControllerManager& manager, unsigned long long int timestampInNs )
+{
+	std::size_t firstRecordIndex = mNextRecordIndex;
+	std::size_t numRecords = mRecording.getNumRecords();
+	while ( mNextRecordIndex<numRecords )
+	{
+		InputRecording::Record record = mRecording.getRecord( mNextRecordIndex );	// A copy: the next one may be in another block
+		if ( record.timestampInNs>timestampInNs )
+			break;
+		++mNextRecordIndex;
+		replayRecord( manager, record );
+	}
+	return mNextRecordIndex - firstRecordIndex;
+}
+
+void ReplayBackend::replayRecord( ControllerManager& manager, const InputRecording::Record& record )
+{
+	DWORD controllerIndex = record.controllerIndex;
+	if ( controllerIndex>=getMaxNumControllers() || controllerIndex>=manager.getMaxNumControllers() )
+		return;		// Error: the recording was made with more controllers
+
+	XINPUT_STATE state;
+	ZeroMemory( &state, sizeof(XINPUT_STATE) );
+	switch ( record.type )
+	{
+		case InputRecorder::RecordType_Connection:
+			{
+				// The Controller applies the state and the battery information it gets 
+				// connected with before anybody listens to it. They were recorded right 
+				// after the connection, with the same timestamp (the state unless its 
+				// packet number was zero, in which case it wasn't applied at all)
+				XINPUT_CAPABILITIES capabilities;
+				InputRecorder::getCapabilities( record, capabilities );
+				connectController( controllerIndex, capabilities );
+				bool hasState = false;
+				while ( mNextRecordIndex<mRecording.getNumRecords() )
+				{
+					const InputRecording::Record& nextRecord = mRecording.getRecord( mNextRecordIndex );
+					if ( nextRecord.controllerIndex!=record.controllerIndex || nextRecord.timestampInNs!=record.timestampInNs )
+						break;
+					if ( nextRecord.type==InputRecorder::RecordType_State && !hasState )
+					{
+						state.dwPacketNumber = nextRecord.packetNumber;
+						state.Gamepad = nextRecord.gamepad;
+						hasState = true;
+					}
+					else if ( nextRecord.type==InputRecorder::RecordType_Battery )
+					{
+						setBatteryInformation( controllerIndex, BATTERY_DEVTYPE_GAMEPAD, nextRecord.batteryInformation[BATTERY_DEVTYPE_GAMEPAD] );
+						setBatteryInformation( controllerIndex, BATTERY_DEVTYPE_HEADSET, nextRecord.batteryInformation[BATTERY_DEVTYPE_HEADSET] );
+					}
+					else
+					{
+						break;
+					}
+					++mNextRecordIndex;
+				}
+			}
+			break;
+
+		case InputRecorder::RecordType_State:
+			{
+				// The recording may start with the controller already connected
+				state.dwPacketNumber = record.packetNumber;
+				state.Gamepad = record.gamepad;
+				if ( !isControllerConnected( controllerIndex ) )
+					connectController( controllerIndex );
+			}
+			break;
+
+		case InputRecorder::RecordType_Disconnection:
+			disconnectController( controllerIndex );
+			manager.updateController( controllerIndex, NULL, record.timestampInNs );
+			return;
+
+		case InputRecorder::RecordType_Battery:
+			// The Controller queries it right away rather than at its next battery update, 
+			// so that it sees the change at its recorded time, after the state packet of the 
+			// same update. Its own battery updates then find nothing new
+			setBatteryInformation( controllerIndex, BATTERY_DEVTYPE_GAMEPAD, record.batteryInformation[BATTERY_DEVTYPE_GAMEPAD] );
+			setBatteryInformation( controllerIndex, BATTERY_DEVTYPE_HEADSET, record.batteryInformation[BATTERY_DEVTYPE_HEADSET] );
+			manager.updateControllerBattery( controllerIndex, record.timestampInNs );
+			return;
+
+		default:
+			return;		// The vibrations aren't replayed
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mStatesMutex );
+		mStates[controllerIndex] = state;
+	}
+	manager.updateController( controllerIndex, &state, record.timestampInNs );
+}
+
+std::size_t ReplayBackend::seek( ControllerManager& manager, unsigned long long int timestampInNs )
+{
+	std::size_t recordIndex = mRecording.findRecord( timestampInNs );
+	std::vector<InputRecording::ControllerState> controllerStates;
+	mRecording.getControllerStates( recordIndex, controllerStates );
+
+	// Bring the controllers to their state at that time
+	DWORD numControllers = std::min( getMaxNumControllers(), manager.getMaxNumControllers() );
+	for ( DWORD i=0; i<numControllers; ++i )
+	{
+		if ( i>=controllerStates.size() || !controllerStates[i].isConnected )
+		{
+			disconnectController( i );
+			manager.updateController( i, NULL, timestampInNs );
+			continue;
+		}
+
+		const XINPUT_STATE& state = controllerStates[i].state;
+		if ( !isControllerConnected( i ) )
+			connectController( i, controllerStates[i].capabilities );
+		setBatteryInformation( i, BATTERY_DEVTYPE_GAMEPAD, controllerStates[i].batteryInformation[BATTERY_DEVTYPE_GAMEPAD] );
+		setBatteryInformation( i, BATTERY_DEVTYPE_HEADSET, controllerStates[i].batteryInformation[BATTERY_DEVTYPE_HEADSET] );
+		{
+			std::lock_guard<std::mutex> lock( mStatesMutex );
+			mStates[i] = state;
+		}
+		manager.updateController( i, &state, timestampInNs );
+		manager.updateControllerBattery( i, timestampInNs );
+	}
+
+	// Carry on from there
+	mNextRecordIndex = recordIndex;
+	mIsStarted = false;
+	return recordIndex;
+}
+
+unsigned long long int ReplayBackend::getReplayedTimestampInNs( unsigned long long int timeInNs ) const
+{
+	if ( mTimeScale==0 )
+		return ~0ULL;
+	double elapsedTimeInNs = static_cast<double>( timeInNs - mStartTimeInNs ) * mTimeScale;
+	return mStartReplayedTimestampInNs + static_cast<unsigned long long int>( elapsedTimeInNs );
+}
+
+DWORD ReplayBackend::getState( DWORD controllerIndex, XINPUT_STATE* state )
+{
+	DWORD result = SyntheticBackend::getState( controllerIndex, state );
+	if ( result!=ERROR_SUCCESS )
+		return result;
+	std::lock_guard<std::mutex> lock( mStatesMutex );
+	*state = mStates[controllerIndex];
+	return ERROR_SUCCESS;
+}
+
+}
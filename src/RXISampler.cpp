@@ -0,0 +1,153 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXISampler.h"
+
+#include "RXIBackend.h"
+#include "RXIControllerManager.h"
+#include "RXITimestamp.h"
+
+#include <chrono>
+
+namespace RXI
+{
+
+Sampler::Sampler( Backend* backend, DWORD numMaxControllers, unsigned int frequencyInHz, std::size_t capacity )
+	:	mBackend(backend),
+		mNumMaxControllers(numMaxControllers),
+		mFrequencyInHz(frequencyInHz),
+		mEnumerationIntervalInMs(1000),
+		mSamples(capacity),
+		mThread(),
+		mStopRequested(false),
+		mNumPolls(0),
+		mNumDroppedSamples(0),
+		mConnected(),
+		mLastPacketNumbers()
+{
+	if ( mFrequencyInHz==0 )
+		mFrequencyInHz = 1;
+	mConnected.resize( mNumMaxControllers, false );
+	mLastPacketNumbers.resize( mNumMaxControllers, 0 );
+}
+
+Sampler::~Sampler()
+{
+	stop();
+}
+
+bool Sampler::start()
+{
+	if ( !mBackend )
+		return false;		// Error: no backend to poll
+	if ( !mBackend->isThreadSafe() )
+		return false;		// Error: the backend can't be polled from the sampler thread
+	if ( isRunning() )
+		return false;		// Error: already started
+	mStopRequested = false;
+	mThread = std::thread( &Sampler::run, this );
+	return true;
+}
+
+void Sampler::stop()
+{
+	if ( !isRunning() )
+		return;
+	mStopRequested = true;
+	mThread.join();
+}
+
+void Sampler::run()
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::duration period = std::chrono::duration_cast<Clock::duration>( std::chrono::nanoseconds( 1000000000ULL / mFrequencyInHz ) );
+	
+	Clock::time_point nextPollTime = Clock::now();
+	unsigned long long int nextEnumerationTimeInNs = Timestamp::getTimestampInNs();
+	while ( !mStopRequested )
+	{
+		unsigned long long int time = Timestamp::getTimestampInNs();
+		bool enumerateControllers = false;
+		if ( time>=nextEnumerationTimeInNs )
+		{
+			enumerateControllers = true;
+			nextEnumerationTimeInNs = time + mEnumerationIntervalInMs*1000000ULL;
+		}
+		poll( enumerateControllers );
+
+		// Keep a steady rate. If we're late (the thread got preempted for example), 
+		// we don't try to catch up with a burst of polls
+		nextPollTime += period;
+		Clock::time_point now = Clock::now();
+		if ( nextPollTime<now )
+			nextPollTime = now;
+		else
+			std::this_thread::sleep_until( nextPollTime );
+	}
+}
+
+void Sampler::poll( bool enumerateControllers )
+{
+	for ( DWORD i=0; i<mNumMaxControllers; ++i )
+	{
+		if ( !mConnected[i] && !enumerateControllers )
+			continue;
+
+		Sample sample;
+		ZeroMemory( &sample, sizeof(Sample) );
+		DWORD dwResult = mBackend->getState( i, &sample.state );
+		bool connected = ( dwResult==ERROR_SUCCESS );
+		
+		// Only publish the changes
+		if ( connected==mConnected[i] && ( !connected || sample.state.dwPacketNumber==mLastPacketNumbers[i] ) )
+			continue;
+
+		sample.timestampInNs = Timestamp::getTimestampInNs();
+		sample.controllerIndex = i;
+		sample.connected = connected;
+		if ( !mSamples.push( sample ) )
+		{
+			// The consumer is lagging behind. We'll publish this change on the next poll
+			mNumDroppedSamples++;
+			continue;
+		}
+		mConnected[i] = connected;
+		mLastPacketNumbers[i] = sample.state.dwPacketNumber;
+	}
+	mNumPolls++;
+}
+
+std::size_t Sampler::drain( ControllerManager& manager, std::size_t maxNumSamples )
+{
+	std::size_t numSamples = 0;
+	Sample sample;
+	while ( numSamples<maxNumSamples && popSample( sample ) )
+	{
+		manager.updateController( sample.controllerIndex, sample.connected ? &sample.state : NULL, sample.timestampInNs );
+		++numSamples;
+	}
+	manager.updateConnectingControllers();
+	return numSamples;
+}
+
+}
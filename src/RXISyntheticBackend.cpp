@@ -0,0 +1,221 @@
+/*
+   The MIT License (MIT) (http://opensource.org/licenses/MIT)
+   
+   Copyright (c) 2015 Jacques Menuet
+   
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+   
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+   
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+#include "RXISyntheticBackend.h"
+
+#include <chrono>
+#include <thread>
+
+namespace RXI
+{
+
+SyntheticBackend::SyntheticBackend( DWORD numMaxControllers )
+	:	mSlots(),
+		mDeviceQueryLatencyInUs(0),
+		mEmptySlotLatencyInUs(0)
+{
+	mSlots.resize( numMaxControllers );
+	for ( DWORD i=0; i<numMaxControllers; ++i )
+		resetSlot( mSlots[i] );
+}
+
+SyntheticBackend::~SyntheticBackend()
+{
+}
+
+void SyntheticBackend::getDefaultCapabilities( XINPUT_CAPABILITIES& capabilities )
+{
+	// The capabilities structure uses non-zero values to indicate the presence of a component
+	ZeroMemory( &capabilities, sizeof(XINPUT_CAPABILITIES) );
+	capabilities.Type = XINPUT_DEVTYPE_GAMEPAD;
+	capabilities.SubType = XINPUT_DEVSUBTYPE_GAMEPAD;
+	capabilities.Flags = 0;
+	capabilities.Gamepad.wButtons = 0xF3FF;		// All the buttons defined by XInput
+	capabilities.Gamepad.bLeftTrigger = 0xFF;
+	capabilities.Gamepad.bRightTrigger = 0xFF;
+	capabilities.Gamepad.sThumbLX = static_cast<SHORT>(0xFFC0);
+	capabilities.Gamepad.sThumbLY = static_cast<SHORT>(0xFFC0);
+	capabilities.Gamepad.sThumbRX = static_cast<SHORT>(0xFFC0);
+	capabilities.Gamepad.sThumbRY = static_cast<SHORT>(0xFFC0);
+	capabilities.Vibration.wLeftMotorSpeed = 0xFF;
+	capabilities.Vibration.wRightMotorSpeed = 0xFF;
+}
+
+void SyntheticBackend::connectController( DWORD controllerIndex )
+{
+	XINPUT_CAPABILITIES capabilities;
+	getDefaultCapabilities( capabilities );
+	connectController( controllerIndex, capabilities );
+}
+
+void SyntheticBackend::connectController( DWORD controllerIndex, const XINPUT_CAPABILITIES& capabilities )
+{
+	if ( controllerIndex>=getMaxNumControllers() )
+		return;			// Error: wrong controller index
+
+	std::lock_guard<std::mutex> lock( mMutex );
+	Slot& slot = mSlots[controllerIndex];
+	slot.connected = true;
+	slot.capabilities = capabilities;
+	ZeroMemory( &slot.state, sizeof(XINPUT_STATE) );
+	ZeroMemory( &slot.vibration, sizeof(XINPUT_VIBRATION) );
+	for ( int i=0; i<2; ++i )
+	{
+		slot.batteryInformation[i].BatteryType = BATTERY_TYPE_WIRED;
+		slot.batteryInformation[i].BatteryLevel = BATTERY_LEVEL_FULL;
+	}
+	slot.batteryInformation[BATTERY_DEVTYPE_HEADSET].BatteryType = BATTERY_TYPE_DISCONNECTED;
+}
+
+void SyntheticBackend::disconnectController( DWORD controllerIndex )
+{
+	if ( controllerIndex>=getMaxNumControllers() )
+		return;			// Error: wrong controller index
+
+	std::lock_guard<std::mutex> lock( mMutex );
+	resetSlot( mSlots[controllerIndex] );
+}
+
+bool SyntheticBackend::isControllerConnected( DWORD controllerIndex ) const
+{
+	if ( controllerIndex>=getMaxNumControllers() )
+		return false;
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mSlots[controllerIndex].connected;
+}
+
+void SyntheticBackend::setGamepad( DWORD controllerIndex, const XINPUT_GAMEPAD& gamepad )
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	Slot* slot = getConnectedSlot( controllerIndex );
+	if ( !slot )
+		return;			// Error: no controller connected at this index
+	slot->state.Gamepad = gamepad;
+	slot->state.dwPacketNumber++;
+}
+
+void SyntheticBackend::setBatteryInformation( DWORD controllerIndex, BYTE devType, const XINPUT_BATTERY_INFORMATION& batteryInformation )
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	Slot* slot = getConnectedSlot( controllerIndex );
+	if ( !slot )
+		return;			// Error: no controller connected at this index
+	if ( devType!=BATTERY_DEVTYPE_GAMEPAD && devType!=BATTERY_DEVTYPE_HEADSET )
+		return;			// Error: unsupported battery device type
+	slot->batteryInformation[devType] = batteryInformation;
+}
+
+bool SyntheticBackend::getVibration( DWORD controllerIndex, XINPUT_VIBRATION& vibration ) const
+{
+	if ( controllerIndex>=getMaxNumControllers() )
+		return false;
+	std::lock_guard<std::mutex> lock( mMutex );
+	const Slot& slot = mSlots[controllerIndex];
+	if ( !slot.connected )
+		return false;
+	vibration = slot.vibration;
+	return true;
+}
+
+DWORD SyntheticBackend::getState( DWORD controllerIndex, XINPUT_STATE* state )
+{
+	if ( !state )
+		return ERROR_BAD_ARGUMENTS;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		Slot* slot = getConnectedSlot( controllerIndex );
+		if ( slot )
+		{
+			*state = slot->state;
+			return ERROR_SUCCESS;
+		}
+	}
+	simulateLatency( mEmptySlotLatencyInUs );
+	return ERROR_DEVICE_NOT_CONNECTED;
+}
+
+DWORD SyntheticBackend::getCapabilities( DWORD controllerIndex, DWORD /*flags*/, XINPUT_CAPABILITIES* capabilities )
+{
+	if ( !capabilities )
+		return ERROR_BAD_ARGUMENTS;
+	simulateLatency( mDeviceQueryLatencyInUs );
+	std::lock_guard<std::mutex> lock( mMutex );
+	Slot* slot = getConnectedSlot( controllerIndex );
+	if ( !slot )
+		return ERROR_DEVICE_NOT_CONNECTED;
+	*capabilities = slot->capabilities;
+	return ERROR_SUCCESS;
+}
+
+DWORD SyntheticBackend::setState( DWORD controllerIndex, XINPUT_VIBRATION* vibration )
+{
+	if ( !vibration )
+		return ERROR_BAD_ARGUMENTS;
+	std::lock_guard<std::mutex> lock( mMutex );
+	Slot* slot = getConnectedSlot( controllerIndex );
+	if ( !slot )
+		return ERROR_DEVICE_NOT_CONNECTED;
+	slot->vibration = *vibration;
+	return ERROR_SUCCESS;
+}
+
+DWORD SyntheticBackend::getBatteryInformation( DWORD controllerIndex, BYTE devType, XINPUT_BATTERY_INFORMATION* batteryInformation )
+{
+	if ( !batteryInformation )
+		return ERROR_BAD_ARGUMENTS;
+	if ( devType!=BATTERY_DEVTYPE_GAMEPAD && devType!=BATTERY_DEVTYPE_HEADSET )
+		return ERROR_BAD_ARGUMENTS;
+	simulateLatency( mDeviceQueryLatencyInUs );
+	std::lock_guard<std::mutex> lock( mMutex );
+	Slot* slot = getConnectedSlot( controllerIndex );
+	if ( !slot )
+		return ERROR_DEVICE_NOT_CONNECTED;
+	*batteryInformation = slot->batteryInformation[devType];
+	return ERROR_SUCCESS;
+}
+
+void SyntheticBackend::resetSlot( Slot& slot )
+{
+	ZeroMemory( &slot, sizeof(Slot) );
+	slot.connected = false;
+}
+
+// Must be called without the mutex locked
+void SyntheticBackend::simulateLatency( unsigned int latencyInUs )
+{
+	if ( latencyInUs>0 )
+		std::this_thread::sleep_for( std::chrono::microseconds(latencyInUs) );
+}
+
+// Must be called with the mutex locked
+SyntheticBackend::Slot* SyntheticBackend::getConnectedSlot( DWORD controllerIndex )
+{
+	if ( controllerIndex>=getMaxNumControllers() )
+		return NULL;
+	Slot& slot = mSlots[controllerIndex];
+	if ( !slot.connected )
+		return NULL;
+	return &slot;
+}
+
+}
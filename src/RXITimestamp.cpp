@@ -23,9 +23,13 @@
 */
 #include "RXITimestamp.h"
 
-#define WIN32_LEAN_AND_MEAN 
-#define NOMINMAX 
-#include <windows.h>
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN 
+	#define NOMINMAX 
+	#include <windows.h>
+#else
+	#include <time.h>
+#endif
 
 namespace RXI
 {
@@ -44,25 +48,41 @@ Timestamp::Timestamp()
 	mTickCountOffset = getCurrentTickCount();
 }
 
-unsigned int Timestamp::getTimestampInMs()
+unsigned long long int Timestamp::getTimestampInNs()
 {
-	unsigned long long int timestampInMs = (getCurrentTickCount() * 1000) / mTickFrequencyInHz;
-	return static_cast<unsigned int>(timestampInMs);
+	unsigned long long int tickCount = getCurrentTickCount() - mTickCountOffset;
+	
+	// Convert the whole seconds and the remainder separately, as multiplying the tick 
+	// count by 10^9 directly would overflow after a few minutes with a 10 MHz counter
+	unsigned long long int seconds = tickCount / mTickFrequencyInHz;
+	unsigned long long int remainder = tickCount % mTickFrequencyInHz;
+	return seconds * 1000000000ULL + ( remainder * 1000000000ULL ) / mTickFrequencyInHz;
 }
 
 unsigned long long int Timestamp::getTickFrequencyInHz()
 {
+#ifdef _WIN32
 	LARGE_INTEGER frequency = { 0, 0 };
 	QueryPerformanceFrequency(&frequency);
 	return frequency.QuadPart;
+#else
+	// The monotonic clock is expressed in nanoseconds
+	return 1000000000ULL;
+#endif
 }
 
 unsigned long long int Timestamp::getCurrentTickCount()
 {
 	unsigned long long int tickCount;
+#ifdef _WIN32
 	LARGE_INTEGER performanceCounter = { 0, 0 };
 	QueryPerformanceCounter(&performanceCounter);
 	tickCount = performanceCounter.QuadPart;
+#else
+	struct timespec now = { 0, 0 };
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	tickCount = static_cast<unsigned long long int>(now.tv_sec) * 1000000000ULL + static_cast<unsigned long long int>(now.tv_nsec);
+#endif
 	return tickCount;
 }
 